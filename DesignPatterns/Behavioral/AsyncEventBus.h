@@ -0,0 +1,503 @@
+/* Asynchronous observer: publishers and subscribers on different threads
+ *
+ * Subject::sendEvent (Observer.h) and EventBus::dispatch (EventBus.h) run the
+ * observers on the publishing thread. Here each subscriber owns a bounded ring
+ * buffer instead:
+ *
+ * 		- any number of producer threads publish into every subscriber's ring
+ * 		  (lock-free, multi producer / single consumer)
+ * 		- the subscriber drains its ring in batches on its own thread, or an
+ * 		  AsyncDrainPool drains many subscribers on a few threads
+ * 		- a full ring is handled by the subscriber's backpressure policy:
+ * 		  Block (producer waits), Drop (event is lost and counted) or Coalesce
+ * 		  (event is merged into one pending overflow event)
+ * 		- stats() reports queue depth, high-water mark, drops and stalls
+ *
+ * Checklist:
+ * 1. Create an AsyncTopic<E> per event type
+ * 2. subscribe() with a batch handler, capacity and policy
+ * 3. Publish from any thread
+ * 4. Call drain() on the subscriber's thread, or add it to an AsyncDrainPool
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+// Bounded multi-producer single-consumer ring (Vyukov's sequence-per-cell queue).
+// Every cell carries a sequence number telling producers and the consumer whose
+// turn it is, so neither side ever takes a lock.
+template <class E>
+class MpscRing
+{
+public:
+	// capacity is rounded up to a power of two
+	explicit MpscRing(size_t capacity)
+	{
+		size_t size = 2;
+		while (size < capacity)
+			size <<= 1;
+
+		m_mask = size - 1;
+		m_cells.reset(new Cell[size]);
+		for (size_t i = 0; i < size; ++i)
+			m_cells[i].sequence.store(i, std::memory_order_relaxed);
+
+		m_enqueue.store(0, std::memory_order_relaxed);
+		m_dequeue.store(0, std::memory_order_relaxed);
+	}
+
+	MpscRing(const MpscRing&) = delete;
+	MpscRing& operator=(const MpscRing&) = delete;
+
+	// Any thread; false when full. retries counts lost races with other producers
+	bool tryPush(const E& event, uint64_t& retries)
+	{
+		size_t position = m_enqueue.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			Cell& cell = m_cells[position & m_mask];
+			const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+			const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+			if (difference == 0)
+			{
+				if (m_enqueue.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				{
+					cell.value = event;
+					cell.sequence.store(position + 1, std::memory_order_release);
+					return true;
+				}
+				++retries;
+			}
+			else if (difference < 0)
+			{
+				// The consumer has not freed this cell yet: full
+				return false;
+			}
+			else
+			{
+				position = m_enqueue.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Consumer thread only; copies up to maxCount events, returns how many
+	size_t popBatch(E* out, size_t maxCount)
+	{
+		size_t position = m_dequeue.load(std::memory_order_relaxed);
+		size_t count = 0;
+		while (count < maxCount)
+		{
+			Cell& cell = m_cells[position & m_mask];
+			if (cell.sequence.load(std::memory_order_acquire) != position + 1)
+				break;
+
+			out[count++] = cell.value;
+			// Hand the cell back to producers for the next lap
+			cell.sequence.store(position + m_mask + 1, std::memory_order_release);
+			++position;
+		}
+
+		m_dequeue.store(position, std::memory_order_relaxed);
+		return count;
+	}
+
+	// Approximate when read while producers and the consumer run
+	size_t depth() const
+	{
+		const size_t enqueued = m_enqueue.load(std::memory_order_relaxed);
+		const size_t dequeued = m_dequeue.load(std::memory_order_relaxed);
+		const size_t depth = enqueued > dequeued ? enqueued - dequeued : 0;
+		return depth < capacity() ? depth : capacity();
+	}
+
+	size_t capacity() const { return m_mask + 1; }
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		E value;
+	};
+
+	std::unique_ptr<Cell[]> m_cells;
+	size_t m_mask;
+
+	// Producers and the consumer write different lines
+	alignas(64) std::atomic<size_t> m_enqueue;
+	alignas(64) std::atomic<size_t> m_dequeue;
+};
+
+enum class EventBackpressure
+{
+	Block,		// producer yields until the subscriber makes room
+	Drop,		// newest event is discarded
+	Coalesce	// newest event is merged into a single overflow event
+};
+
+struct AsyncSubscriberStats
+{
+	uint64_t published = 0;
+	uint64_t delivered = 0;
+	uint64_t dropped = 0;
+	uint64_t coalesced = 0;
+
+	// Times a producer found the ring full and had to wait (Block policy)
+	uint64_t blocked = 0;
+	// Lost CAS races between producers
+	uint64_t casRetries = 0;
+
+	uint64_t depth = 0;
+	uint64_t highWaterMark = 0;
+	uint64_t capacity = 0;
+
+	void print(std::ostream& out) const
+	{
+		out << "subscriber: depth " << depth << " / capacity " << capacity << " (high-water " << highWaterMark << "), "
+			<< published << " published, " << delivered << " delivered, "
+			<< dropped << " dropped, " << coalesced << " coalesced, "
+			<< blocked << " blocked, " << casRetries << " CAS retries\n";
+	}
+};
+
+template <class E>
+class AsyncSubscriber
+{
+public:
+	typedef std::function<void(const E* events, size_t count)> Handler;
+	// Folds an overflowing event into the pending one (Coalesce policy)
+	typedef std::function<void(E& pending, const E& incoming)> Merge;
+
+	AsyncSubscriber(Handler handler, size_t capacity, EventBackpressure policy, Merge merge = Merge())
+		: m_ring(capacity)
+		, m_handler(std::move(handler))
+		, m_merge(merge ? std::move(merge) : Merge([](E& pending, const E& incoming) { pending = incoming; }))
+		, m_policy(policy)
+		, m_batch(m_ring.capacity())
+		, m_hasPending(false)
+		, m_draining(false)
+	{
+	}
+
+	// Producer side, any thread
+	void push(const E& event)
+	{
+		uint64_t retries = 0;
+
+		// Once an overflow event is pending, newer events merge into it too, so
+		// nothing queued in the ring is newer than the pending event
+		bool delivered = !(m_policy == EventBackpressure::Coalesce && m_hasPending.load(std::memory_order_acquire))
+			&& m_ring.tryPush(event, retries);
+
+		if (!delivered)
+		{
+			switch (m_policy)
+			{
+			case EventBackpressure::Block:
+				m_counters.blocked.fetch_add(1, std::memory_order_relaxed);
+				while (!(delivered = m_ring.tryPush(event, retries)))
+					std::this_thread::yield();
+				break;
+
+			case EventBackpressure::Drop:
+				m_counters.dropped.fetch_add(1, std::memory_order_relaxed);
+				break;
+
+			case EventBackpressure::Coalesce:
+			{
+				// Overflow path only, so a lock is fine here
+				std::lock_guard<std::mutex> lock(m_pendingMutex);
+				if (m_hasPending.load(std::memory_order_relaxed))
+					m_merge(m_pending, event);
+				else
+					m_pending = event;
+				m_hasPending.store(true, std::memory_order_release);
+				m_counters.coalesced.fetch_add(1, std::memory_order_relaxed);
+				break;
+			}
+			}
+		}
+
+		m_counters.published.fetch_add(1, std::memory_order_relaxed);
+		if (retries)
+			m_counters.casRetries.fetch_add(retries, std::memory_order_relaxed);
+		if (delivered)
+			updateHighWaterMark(m_ring.depth());
+	}
+
+	// Consumer side: deliver what is queued, in batches of up to maxBatch and at
+	// most one ring's worth per call, so busy producers can not pin the drainer.
+	// Returns the number of events handled; 0 (without waiting) if another
+	// thread is already draining this subscriber.
+	size_t drain(size_t maxBatch = SIZE_MAX)
+	{
+		if (m_draining.exchange(true, std::memory_order_acquire))
+			return 0;
+
+		size_t total = 0;
+		bool emptied = false;
+		const size_t batchSize = maxBatch < m_batch.size() ? maxBatch : m_batch.size();
+		while (total < m_ring.capacity())
+		{
+			const size_t count = m_ring.popBatch(m_batch.data(), batchSize);
+			if (count == 0)
+			{
+				emptied = true;
+				break;
+			}
+
+			m_handler(m_batch.data(), count);
+			total += count;
+		}
+
+		// The merged overflow event is newer than everything in the ring, so it
+		// waits for a later call if this one stopped at its limit
+		if (emptied && m_hasPending.load(std::memory_order_acquire))
+		{
+			E pending;
+			{
+				std::lock_guard<std::mutex> lock(m_pendingMutex);
+				pending = m_pending;
+				m_hasPending.store(false, std::memory_order_relaxed);
+			}
+			m_handler(&pending, 1);
+			++total;
+		}
+
+		m_counters.delivered.fetch_add(total, std::memory_order_relaxed);
+		m_draining.store(false, std::memory_order_release);
+		return total;
+	}
+
+	size_t depth() const { return m_ring.depth(); }
+
+	AsyncSubscriberStats stats() const
+	{
+		AsyncSubscriberStats stats;
+		stats.published = m_counters.published.load(std::memory_order_relaxed);
+		stats.delivered = m_counters.delivered.load(std::memory_order_relaxed);
+		stats.dropped = m_counters.dropped.load(std::memory_order_relaxed);
+		stats.coalesced = m_counters.coalesced.load(std::memory_order_relaxed);
+		stats.blocked = m_counters.blocked.load(std::memory_order_relaxed);
+		stats.casRetries = m_counters.casRetries.load(std::memory_order_relaxed);
+		stats.depth = m_ring.depth();
+		stats.highWaterMark = m_counters.highWaterMark.load(std::memory_order_relaxed);
+		stats.capacity = m_ring.capacity();
+		return stats;
+	}
+
+private:
+	void updateHighWaterMark(size_t depth)
+	{
+		size_t mark = m_counters.highWaterMark.load(std::memory_order_relaxed);
+		while (depth > mark && !m_counters.highWaterMark.compare_exchange_weak(mark, depth, std::memory_order_relaxed))
+		{
+		}
+	}
+
+private:
+	MpscRing<E> m_ring;
+	Handler m_handler;
+	Merge m_merge;
+	EventBackpressure m_policy;
+
+	// Consumer-owned batch buffer, sized once
+	std::vector<E> m_batch;
+
+	std::mutex m_pendingMutex;
+	E m_pending;
+	std::atomic<bool> m_hasPending;
+
+	std::atomic<bool> m_draining;
+
+	// Bumped by every producer; kept off the ring's lines
+	struct alignas(64) Counters
+	{
+		std::atomic<uint64_t> published{ 0 };
+		std::atomic<uint64_t> delivered{ 0 };
+		std::atomic<uint64_t> dropped{ 0 };
+		std::atomic<uint64_t> coalesced{ 0 };
+		std::atomic<uint64_t> blocked{ 0 };
+		std::atomic<uint64_t> casRetries{ 0 };
+		std::atomic<size_t> highWaterMark{ 0 };
+	};
+	Counters m_counters;
+};
+
+// Publishing side for one event type. The subscriber list is copy-on-write, so
+// publish() never waits on subscribe / unsubscribe; subscribers stay alive while
+// a publisher may still be pushing into them. The list pointer is read with
+// std::atomic_load, so reads are only as lock-free as the standard library makes
+// that (see the note in Stats/BayesClassifier/ConcurrentBayesClassifier.h).
+template <class E>
+class AsyncTopic
+{
+public:
+	typedef std::shared_ptr<AsyncSubscriber<E>> SubscriberPtr;
+	typedef std::vector<SubscriberPtr> SubscriberList;
+
+	AsyncTopic() : m_subscribers(std::make_shared<SubscriberList>()) { }
+
+	SubscriberPtr subscribe(typename AsyncSubscriber<E>::Handler handler, size_t capacity = 1024,
+		EventBackpressure policy = EventBackpressure::Block, typename AsyncSubscriber<E>::Merge merge = typename AsyncSubscriber<E>::Merge())
+	{
+		SubscriberPtr subscriber = std::make_shared<AsyncSubscriber<E>>(std::move(handler), capacity, policy, std::move(merge));
+
+		std::lock_guard<std::mutex> lock(m_writeMutex);
+		std::shared_ptr<SubscriberList> list = std::make_shared<SubscriberList>(*std::atomic_load(&m_subscribers));
+		list->push_back(subscriber);
+		std::atomic_store(&m_subscribers, std::shared_ptr<const SubscriberList>(list));
+		return subscriber;
+	}
+
+	void unsubscribe(const SubscriberPtr& subscriber)
+	{
+		std::lock_guard<std::mutex> lock(m_writeMutex);
+		std::shared_ptr<SubscriberList> list = std::make_shared<SubscriberList>(*std::atomic_load(&m_subscribers));
+		for (size_t s = 0; s < list->size(); ++s)
+		{
+			if ((*list)[s] == subscriber)
+			{
+				(*list)[s] = list->back();
+				list->pop_back();
+				break;
+			}
+		}
+		std::atomic_store(&m_subscribers, std::shared_ptr<const SubscriberList>(list));
+	}
+
+	// [3] Any thread
+	void publish(const E& event)
+	{
+		std::shared_ptr<const SubscriberList> list = std::atomic_load(&m_subscribers);
+		for (const SubscriberPtr& subscriber : *list)
+			subscriber->push(event);
+	}
+
+private:
+	std::shared_ptr<const SubscriberList> m_subscribers;
+	std::mutex m_writeMutex;
+};
+
+// A few threads draining many subscribers. A subscriber is never drained by two
+// threads at once; idle workers back off to a short sleep.
+class AsyncDrainPool
+{
+public:
+	typedef std::function<size_t()> Drain;
+
+	explicit AsyncDrainPool(unsigned threadCount = 2)
+		: m_drains(std::make_shared<std::vector<Drain>>())
+		, m_stop(false)
+	{
+		for (unsigned t = 0; t < (threadCount ? threadCount : 1); ++t)
+			m_threads.emplace_back([this, t]() { run(t); });
+	}
+
+	~AsyncDrainPool()
+	{
+		m_stop.store(true, std::memory_order_relaxed);
+		for (std::thread& thread : m_threads)
+			thread.join();
+	}
+
+	AsyncDrainPool(const AsyncDrainPool&) = delete;
+	AsyncDrainPool& operator=(const AsyncDrainPool&) = delete;
+
+	template <class E>
+	void add(std::shared_ptr<AsyncSubscriber<E>> subscriber, size_t maxBatch = 256)
+	{
+		std::lock_guard<std::mutex> lock(m_writeMutex);
+		std::shared_ptr<std::vector<Drain>> drains = std::make_shared<std::vector<Drain>>(*std::atomic_load(&m_drains));
+		drains->push_back([subscriber, maxBatch]() { return subscriber->drain(maxBatch); });
+		std::atomic_store(&m_drains, std::shared_ptr<const std::vector<Drain>>(drains));
+	}
+
+private:
+	void run(unsigned worker)
+	{
+		unsigned idle = 0;
+		while (!m_stop.load(std::memory_order_relaxed))
+		{
+			std::shared_ptr<const std::vector<Drain>> drains = std::atomic_load(&m_drains);
+
+			// Workers start at different subscribers so they rarely collide
+			size_t handled = 0;
+			const size_t count = drains->size();
+			for (size_t d = 0; d < count; ++d)
+				handled += (*drains)[(d + worker) % count]();
+
+			if (handled)
+				idle = 0;
+			else if (++idle < 64)
+				std::this_thread::yield();
+			else
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+	}
+
+private:
+	std::shared_ptr<const std::vector<Drain>> m_drains;
+	std::mutex m_writeMutex;
+	std::vector<std::thread> m_threads;
+	std::atomic<bool> m_stop;
+};
+
+// How it's used ???
+namespace async_event_bus
+{
+	struct PositionEvent
+	{
+		uint32_t entity;
+		float x, y;
+	};
+
+	void example()
+	{
+		AsyncTopic<PositionEvent> positions;
+
+		// Renderer only cares about the latest position when it falls behind
+		std::atomic<uint64_t> rendered(0);
+		auto renderer = positions.subscribe([&](const PositionEvent*, size_t count) { rendered += count; },
+			256, EventBackpressure::Coalesce);
+
+		// Logger must see everything, producers wait for it
+		std::atomic<uint64_t> logged(0);
+		auto logger = positions.subscribe([&](const PositionEvent*, size_t count) { logged += count; },
+			4096, EventBackpressure::Block);
+
+		{
+			AsyncDrainPool pool(2);
+			pool.add(renderer);
+			pool.add(logger);
+
+			// Several simulation threads publish at once
+			std::vector<std::thread> producers;
+			for (uint32_t t = 0; t < 4; ++t)
+			{
+				producers.emplace_back([&positions, t]() {
+					for (uint32_t i = 0; i < 100000; ++i)
+						positions.publish(PositionEvent{ t, static_cast<float>(i), 0.0f });
+				});
+			}
+			for (std::thread& producer : producers)
+				producer.join();
+		}
+
+		// Whatever the pool had not reached yet
+		renderer->drain();
+		logger->drain();
+
+		renderer->stats().print(std::cout);
+		logger->stats().print(std::cout);
+	}
+}
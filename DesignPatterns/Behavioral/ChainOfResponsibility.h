@@ -11,18 +11,175 @@
  * such as input handlers and dispatchers linked up together or
  * a mouse click "penetrating" through layers of mouse input hitzones
  * 
+ * Batch mode: handleBatch() gets a whole span of requests plus a bitmask of the
+ * ones still unconsumed, one bit per request. A handler processes all of its
+ * requests in one call and clears the bits of what it stopped, so only the
+ * survivors reach the next handler. Simple predicates are evaluated 4 requests
+ * at a time with SSE2.
+ * Note: in batch mode a handler sees all of its requests before the next
+ * handler sees any, so handlers must not rely on interleaving across requests.
+ * 
  */
 
 #pragma once
 
 #include <iostream>
+#include <stdint.h>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HANDLER_BATCH_SSE2
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// What a handler does with a request: ACT runs process(), STOP ends the chain
+enum HandlerAction : unsigned
+{
+	HANDLER_PASS = 0,		// not interested, next handler
+	HANDLER_HANDLE = 1,		// act, then pass on
+	HANDLER_DROP = 2,		// swallow without acting
+	HANDLER_CONSUME = 3		// act and stop
+};
+
+const unsigned HANDLER_ACT = 1;
+const unsigned HANDLER_STOP = 2;
+
+// !!! Batch helpers: requests are processed in blocks of 64, one mask word each
+namespace handler_batch
+{
+	const size_t BLOCK = 64;
+
+	inline size_t wordCount(size_t count) { return (count + BLOCK - 1) / BLOCK; }
+
+	// Mask with a bit for every request of block word
+	inline uint64_t fullMask(size_t count, size_t word)
+	{
+		const size_t rest = count - word * BLOCK;
+		return rest >= BLOCK ? ~0ULL : (1ULL << rest) - 1;
+	}
+
+	inline unsigned lowestBit(uint64_t mask)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward64(&index, mask);
+		return index;
+#else
+		return __builtin_ctzll(mask);
+#endif
+	}
+
+	// Bit i set where requests[i] is even, for up to 64 requests
+	inline uint64_t evenMask(const int* requests, size_t count)
+	{
+		uint64_t mask = 0;
+		size_t i = 0;
+#ifdef HANDLER_BATCH_SSE2
+		const __m128i one = _mm_set1_epi32(1);
+		const __m128i zero = _mm_setzero_si128();
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128i lanes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(requests + i));
+			const __m128i even = _mm_cmpeq_epi32(_mm_and_si128(lanes, one), zero);
+			mask |= static_cast<uint64_t>(_mm_movemask_ps(_mm_castsi128_ps(even))) << i;
+		}
+#endif
+		for (; i < count; ++i)
+			mask |= static_cast<uint64_t>(requests[i] % 2 == 0) << i;
+		return mask;
+	}
+
+	// Bit i set where requests[i] > threshold, for up to 64 requests
+	inline uint64_t greaterMask(const int* requests, size_t count, int threshold)
+	{
+		uint64_t mask = 0;
+		size_t i = 0;
+#ifdef HANDLER_BATCH_SSE2
+		const __m128i limit = _mm_set1_epi32(threshold);
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128i lanes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(requests + i));
+			const __m128i greater = _mm_cmpgt_epi32(lanes, limit);
+			mask |= static_cast<uint64_t>(_mm_movemask_ps(_mm_castsi128_ps(greater))) << i;
+		}
+#endif
+		for (; i < count; ++i)
+			mask |= static_cast<uint64_t>(requests[i] > threshold) << i;
+		return mask;
+	}
+}
 
 // !!! handler base
+// A handler is split into a side effect free decision (classify) and the work
+// itself (process), so a chain can be flattened and precomputed (HandlerChain.h)
 class HandlerBase
 {
 public:
+	HandlerBase() : m_next(nullptr) { }
+	virtual ~HandlerBase() { }
+
 	void setNext(HandlerBase* handler) { m_next = handler; }
-	virtual void handle(int request);
+	HandlerBase* getNext() const { return m_next; }
+
+	virtual HandlerAction classify(int request) const = 0;
+	virtual void process(int request) = 0;
+
+	// Opt in: true when classify() depends on the request only (no handler
+	// state), so its answer for a given request can be computed once and cached
+	virtual bool isStatic() const { return false; }
+
+	// Walks the linked chain, one virtual call per hop
+	void handle(int request)
+	{
+		for (HandlerBase* handler = this; handler; handler = handler->m_next)
+		{
+			const unsigned action = handler->classify(request);
+			if (action & HANDLER_ACT)
+				handler->process(request);
+			if (action & HANDLER_STOP)
+				return;
+		}
+	}
+
+	// Batch mode: one virtual call per hop for the whole span
+	void handle(const int* requests, size_t count)
+	{
+		std::vector<uint64_t> unconsumed(handler_batch::wordCount(count));
+		for (size_t w = 0; w < unconsumed.size(); ++w)
+			unconsumed[w] = handler_batch::fullMask(count, w);
+
+		for (HandlerBase* handler = this; handler && count; handler = handler->m_next)
+		{
+			if (!handler->handleBatch(requests, count, unconsumed.data()))
+				return;
+		}
+	}
+
+	// Process the requests whose bit is set in unconsumed and clear the bits of
+	// those stopped here; returns false when nothing is left. The default goes
+	// through classify() per request, override it to evaluate predicates in bulk.
+	virtual bool handleBatch(const int* requests, size_t count, uint64_t* unconsumed)
+	{
+		uint64_t left = 0;
+		for (size_t w = 0; w < handler_batch::wordCount(count); ++w)
+		{
+			for (uint64_t bits = unconsumed[w]; bits; bits &= bits - 1)
+			{
+				const size_t i = w * handler_batch::BLOCK + handler_batch::lowestBit(bits);
+				const unsigned action = classify(requests[i]);
+				if (action & HANDLER_ACT)
+					process(requests[i]);
+				if (action & HANDLER_STOP)
+					unconsumed[w] &= ~(1ULL << (i % handler_batch::BLOCK));
+			}
+			left |= unconsumed[w];
+		}
+		return left != 0;
+	}
 
 protected:
 	HandlerBase* m_next;
@@ -33,13 +190,16 @@ protected:
 class Handler1 : public HandlerBase
 {
 public:
-	void handle(int request) override
+	HandlerAction classify(int request) const override
 	{
-		if (request == 0)
-			std::cout << "Handler 1 handles!\n";
+		return request == 0 ? HANDLER_HANDLE : HANDLER_PASS;
+	}
 
-		if (m_next)
-			m_next->handle(request);
+	bool isStatic() const override { return true; }
+
+	void process(int /*request*/) override
+	{
+		std::cout << "Handler 1 handles!\n";
 	}
 };
 
@@ -47,12 +207,33 @@ public:
 class Handler2 : public HandlerBase
 {
 public:
-	void handle(int request) override
+	HandlerAction classify(int request) const override
 	{
-		if (request % 2 == 0)
-			std::cout << "Handler 2 handles!\n";
-		else if (m_next)
-			m_next->handle(request);
+		return request % 2 == 0 ? HANDLER_CONSUME : HANDLER_PASS;
+	}
+
+	bool isStatic() const override { return true; }
+
+	void process(int /*request*/) override
+	{
+		std::cout << "Handler 2 handles!\n";
+	}
+
+	bool handleBatch(const int* requests, size_t count, uint64_t* unconsumed) override
+	{
+		uint64_t left = 0;
+		for (size_t w = 0; w < handler_batch::wordCount(count); ++w)
+		{
+			const size_t base = w * handler_batch::BLOCK;
+			const size_t length = count - base < handler_batch::BLOCK ? count - base : handler_batch::BLOCK;
+			const uint64_t even = unconsumed[w] & handler_batch::evenMask(requests + base, length);
+
+			for (uint64_t bits = even; bits; bits &= bits - 1)
+				process(requests[base + handler_batch::lowestBit(bits)]);
+			unconsumed[w] &= ~even;
+			left |= unconsumed[w];
+		}
+		return left != 0;
 	}
 };
 
@@ -60,9 +241,30 @@ public:
 class Handler3 : public HandlerBase
 {
 public:
-	void handle(int request) override
+	HandlerAction classify(int request) const override
 	{
-		if (request > 10)
-			std::cout << "Handler 3 handles!\n";
+		return request > 10 ? HANDLER_CONSUME : HANDLER_DROP;
+	}
+
+	bool isStatic() const override { return true; }
+
+	void process(int /*request*/) override
+	{
+		std::cout << "Handler 3 handles!\n";
+	}
+
+	bool handleBatch(const int* requests, size_t count, uint64_t* unconsumed) override
+	{
+		for (size_t w = 0; w < handler_batch::wordCount(count); ++w)
+		{
+			const size_t base = w * handler_batch::BLOCK;
+			const size_t length = count - base < handler_batch::BLOCK ? count - base : handler_batch::BLOCK;
+			const uint64_t greater = unconsumed[w] & handler_batch::greaterMask(requests + base, length, 10);
+
+			for (uint64_t bits = greater; bits; bits &= bits - 1)
+				process(requests[base + handler_batch::lowestBit(bits)]);
+			unconsumed[w] = 0;
+		}
+		return false;
 	}
 };
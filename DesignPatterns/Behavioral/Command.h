@@ -17,6 +17,9 @@
  * 
  * Source: https://en.wikipedia.org/wiki/Command_pattern#UML_class_diagram
  * Source: https://sourcemaking.com/design_patterns/command
+ *
+ * One heap object and one virtual call per command does not scale to replaying
+ * millions of them; see CommandBuffer.h for POD command records executed in batches.
  */
 
 #pragma once
@@ -34,6 +37,12 @@ public:
 	void moveRight() { m_x++; update(); }
 	void update() const { std::cout << "Player is at (" << m_x << ", " << m_y << ").\n"; }
 
+	// Quiet versions for batched execution (no output per step)
+	void translate(int dx, int dy) { m_x += dx; m_y += dy; }
+	void setPosition(int x, int y) { m_x = x; m_y = y; }
+	int getX() const { return m_x; }
+	int getY() const { return m_y; }
+
 private:
 	int m_x;
 	int m_y;
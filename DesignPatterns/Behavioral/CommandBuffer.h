@@ -0,0 +1,293 @@
+/* Command buffer: commands as plain records instead of objects
+ *
+ * The ICommand classes (Command.h) are one heap object and one virtual call per
+ * command. For deterministic replay of millions of commands we want:
+ *
+ * 		- commands as small POD records (type tag + payload) stored contiguously
+ * 		- execution as a tight loop over the records, a switch on the tag
+ * 		- coalescing while recording: e.g. consecutive moves of one player merge
+ * 		  into a single delta, so fewer records are stored and executed
+ * 		- undo/redo by recording an inverse record for every executed record
+ *
+ * The buffer is generic; a Traits class describes the commands:
+ *
+ * 	struct Traits
+ * 	{
+ * 		typedef ... Record;		// POD command record
+ * 		typedef ... Context;	// what the commands act on
+ *
+ * 		// Try to fold next into last (the previous recorded command)
+ * 		static bool coalesce(Record& last, const Record& next);
+ *
+ * 		// Apply record to context; return the record that undoes it
+ * 		static Record execute(Context& context, const Record& record);
+ *
+ * 		// Optional, for CommandScheduler: resources the record reads / writes
+ * 		template <class Access>
+ * 		static void access(const Record& record, Access& access);
+ * 	};
+ *
+ * Checklist:
+ * 1. record() commands as they come in (from input, network, a replay file...)
+ * 2. execute() runs everything recorded as one undoable step
+ * 3. undo() / redo() step through the history
+ * 4. replay() runs a recorded array without keeping any history (fastest path)
+ */
+
+#pragma once
+
+#include <iostream>
+#include <stdint.h>
+#include <vector>
+#include "Command.h"
+
+template <class Traits>
+class CommandBuffer
+{
+public:
+	typedef typename Traits::Record Record;
+	typedef typename Traits::Context Context;
+
+	CommandBuffer() : m_coalescing(true), m_coalesced(0) { }
+
+	// Coalescing may be switched off when every record must be kept as issued
+	void setCoalescing(bool coalescing) { m_coalescing = coalescing; }
+
+	// [1]
+	void record(const Record& command)
+	{
+		if (m_coalescing && !m_pending.empty() && Traits::coalesce(m_pending.back(), command))
+		{
+			m_coalesced++;
+			return;
+		}
+		m_pending.push_back(command);
+	}
+
+	// [2] Run the recorded commands as one undoable step; returns how many ran
+	size_t execute(Context& context)
+	{
+		if (m_pending.empty())
+			return 0;
+
+		// Anything undone is no longer redoable once new commands run
+		m_redo.clear();
+		m_redoSteps.clear();
+
+		run(context, m_pending.data(), m_pending.size(), m_undo);
+		m_undoSteps.push_back(m_undo.size());
+
+		const size_t count = m_pending.size();
+		m_pending.clear();
+		return count;
+	}
+
+	// Same, with independent records run in parallel (see CommandScheduler.h)
+	template <class Scheduler>
+	size_t execute(Context& context, Scheduler& scheduler)
+	{
+		if (m_pending.empty())
+			return 0;
+
+		m_redo.clear();
+		m_redoSteps.clear();
+
+		const size_t base = m_undo.size();
+		m_undo.resize(base + m_pending.size());
+		scheduler.run(context, m_pending.data(), m_pending.size(), m_undo.data() + base);
+		m_undoSteps.push_back(m_undo.size());
+
+		const size_t count = m_pending.size();
+		m_pending.clear();
+		return count;
+	}
+
+	// [3] The inverse records of the last step run newest first, and what they
+	// return (the original records) becomes the redo step
+	bool undo(Context& context)
+	{
+		return step(context, m_undo, m_undoSteps, m_redo, m_redoSteps);
+	}
+
+	bool redo(Context& context)
+	{
+		return step(context, m_redo, m_redoSteps, m_undo, m_undoSteps);
+	}
+
+	// [4] No coalescing, no inverses: replay a recording as fast as possible
+	static void replay(Context& context, const Record* records, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			Traits::execute(context, records[i]);
+	}
+
+	const std::vector<Record>& pending() const { return m_pending; }
+	size_t undoSteps() const { return m_undoSteps.size(); }
+	size_t redoSteps() const { return m_redoSteps.size(); }
+	size_t coalescedCount() const { return m_coalesced; }
+
+	void clearHistory()
+	{
+		m_undo.clear();
+		m_undoSteps.clear();
+		m_redo.clear();
+		m_redoSteps.clear();
+	}
+
+private:
+	static void run(Context& context, const Record* records, size_t count, std::vector<Record>& inverses)
+	{
+		// Grow once, then write inverses straight into place
+		const size_t base = inverses.size();
+		inverses.resize(base + count);
+		Record* out = inverses.data() + base;
+		for (size_t i = 0; i < count; ++i)
+			out[i] = Traits::execute(context, records[i]);
+	}
+
+	// Pops one step off from (records + end offsets), runs it in reverse order
+	// and pushes the resulting inverses as one step onto to
+	static bool step(Context& context, std::vector<Record>& from, std::vector<size_t>& fromSteps,
+		std::vector<Record>& to, std::vector<size_t>& toSteps)
+	{
+		if (fromSteps.empty())
+			return false;
+
+		fromSteps.pop_back();
+		const size_t begin = fromSteps.empty() ? 0 : fromSteps.back();
+		const size_t count = from.size() - begin;
+
+		const size_t base = to.size();
+		to.resize(base + count);
+		for (size_t i = 0; i < count; ++i)
+			to[base + i] = Traits::execute(context, from[from.size() - 1 - i]);
+
+		from.resize(begin);
+		toSteps.push_back(to.size());
+		return true;
+	}
+
+private:
+	std::vector<Record> m_pending;
+
+	// Inverse records of executed steps back to back; m_undoSteps holds where each step ends
+	std::vector<Record> m_undo;
+	std::vector<size_t> m_undoSteps;
+	std::vector<Record> m_redo;
+	std::vector<size_t> m_redoSteps;
+
+	bool m_coalescing;
+	size_t m_coalesced;
+};
+
+// !!! Records for the Player commands of Command.h: 16 bytes, no pointers,
+// so a recording can be written to disk and replayed as is
+struct PlayerCommand
+{
+	enum Type : uint32_t
+	{
+		MOVE,			// x, y: delta
+		SET_POSITION	// x, y: absolute
+	};
+
+	uint32_t type;
+	uint32_t player;	// index into the players array
+	int32_t x;
+	int32_t y;
+
+	static PlayerCommand moveUp(uint32_t player) { return PlayerCommand{ MOVE, player, 0, 1 }; }
+	static PlayerCommand moveDown(uint32_t player) { return PlayerCommand{ MOVE, player, 0, -1 }; }
+	static PlayerCommand moveLeft(uint32_t player) { return PlayerCommand{ MOVE, player, -1, 0 }; }
+	static PlayerCommand moveRight(uint32_t player) { return PlayerCommand{ MOVE, player, 1, 0 }; }
+	static PlayerCommand setPosition(uint32_t player, int32_t x, int32_t y) { return PlayerCommand{ SET_POSITION, player, x, y }; }
+};
+
+struct PlayerCommandTraits
+{
+	typedef PlayerCommand Record;
+	typedef std::vector<Player> Context;
+
+	static bool coalesce(Record& last, const Record& next)
+	{
+		if (last.player != next.player)
+			return false;
+
+		switch (next.type)
+		{
+		case PlayerCommand::MOVE:
+			// Move after move or after set: fold the delta in
+			last.x += next.x;
+			last.y += next.y;
+			return true;
+
+		case PlayerCommand::SET_POSITION:
+			// Setting the position overrides whatever came right before
+			last = next;
+			return true;
+		}
+		return false;
+	}
+
+	// Each command touches exactly its own player
+	template <class Access>
+	static void access(const Record& command, Access& access)
+	{
+		access.write(command.player);
+	}
+
+	static Record execute(Context& players, const Record& command)
+	{
+		Player& player = players[command.player];
+		switch (command.type)
+		{
+		case PlayerCommand::MOVE:
+			player.translate(command.x, command.y);
+			return PlayerCommand{ PlayerCommand::MOVE, command.player, -command.x, -command.y };
+
+		case PlayerCommand::SET_POSITION:
+		default:
+		{
+			const PlayerCommand inverse = PlayerCommand::setPosition(command.player, player.getX(), player.getY());
+			player.setPosition(command.x, command.y);
+			return inverse;
+		}
+		}
+	}
+};
+
+typedef CommandBuffer<PlayerCommandTraits> PlayerCommandBuffer;
+
+// How it's used ???
+namespace command_buffer
+{
+	void example()
+	{
+		std::vector<Player> players(2);
+		PlayerCommandBuffer commands;
+
+		// Input for one frame: three ups and a right collapse into one record
+		commands.record(PlayerCommand::moveUp(0));
+		commands.record(PlayerCommand::moveUp(0));
+		commands.record(PlayerCommand::moveUp(0));
+		commands.record(PlayerCommand::moveRight(0));
+		commands.record(PlayerCommand::setPosition(1, 10, 10));
+		commands.execute(players);
+		players[0].update();	// (1, 3)
+		players[1].update();	// (10, 10)
+
+		commands.undo(players);
+		players[0].update();	// (0, 0)
+		players[1].update();	// (0, 0)
+
+		commands.redo(players);
+		players[0].update();	// (1, 3)
+
+		// Deterministic replay of a long recording, no history kept
+		std::vector<PlayerCommand> recording;
+		for (uint32_t i = 0; i < 4096; ++i)
+			recording.push_back(i % 2 ? PlayerCommand::moveUp(i % 2) : PlayerCommand::moveLeft(i % 2));
+		PlayerCommandBuffer::replay(players, recording.data(), recording.size());
+		players[0].update();
+		players[1].update();
+	}
+}
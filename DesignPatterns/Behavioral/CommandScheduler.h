@@ -0,0 +1,404 @@
+/* Parallel command execution with dependency tracking
+ *
+ * CommandBuffer (CommandBuffer.h) runs a batch in order on one thread. When the
+ * commands of a batch mostly touch different entities they can run at the same
+ * time; only commands that conflict must keep their recorded order.
+ *
+ * 		- every record declares what it reads and writes (resource ids, e.g. the
+ * 		  player index) through Traits::access()
+ * 		- per batch, a dependency graph is built in recording order:
+ * 		  write-after-write, read-after-write and write-after-read are edges,
+ * 		  reads of the same resource are not
+ * 		- commands with no pending predecessors run on a work-stealing pool: each
+ * 		  worker pushes newly ready commands onto its own queue and idle workers
+ * 		  steal from the others
+ *
+ * The result is the same as running the batch in order, as long as the declared
+ * access sets are complete. A command declaring more than MAX_RESOURCES reads or
+ * writes becomes a barrier: it runs after everything before it and before
+ * everything after it.
+ *
+ * Checklist:
+ * 1. Add to the command Traits:
+ * 		static void access(const Record& record, CommandAccess& access);
+ * 2. Make Traits::execute safe to run concurrently on disjoint resources
+ * 3. Pass a CommandScheduler to CommandBuffer::execute
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "CommandBuffer.h"
+
+// Declared read / write set of one command; small and fixed so records stay POD
+struct CommandAccess
+{
+	static const unsigned MAX_RESOURCES = 4;
+
+	uint32_t reads[MAX_RESOURCES];
+	uint32_t writes[MAX_RESOURCES];
+	unsigned readCount = 0;
+	unsigned writeCount = 0;
+
+	// Set when more resources were declared than fit; the command is then
+	// scheduled as a barrier instead
+	bool overflow = false;
+
+	void read(uint32_t resource)
+	{
+		if (readCount < MAX_RESOURCES)
+			reads[readCount++] = resource;
+		else
+			overflow = true;
+	}
+
+	void write(uint32_t resource)
+	{
+		if (writeCount < MAX_RESOURCES)
+			writes[writeCount++] = resource;
+		else
+			overflow = true;
+	}
+};
+
+template <class Traits>
+class CommandScheduler
+{
+public:
+	typedef typename Traits::Record Record;
+	typedef typename Traits::Context Context;
+
+	// threadCount includes the calling thread; 0 picks the hardware concurrency
+	explicit CommandScheduler(unsigned threadCount = 0, size_t serialThreshold = 256)
+		: m_serialThreshold(serialThreshold)
+		, m_generation(0)
+		, m_stop(false)
+		, m_active(0)
+		, m_remaining(0)
+		, m_context(nullptr)
+		, m_records(nullptr)
+		, m_inverses(nullptr)
+	{
+		if (threadCount == 0)
+			threadCount = std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1;
+
+		m_queues.reset(new WorkQueue[threadCount]);
+		m_queueCount = threadCount;
+		for (unsigned w = 1; w < threadCount; ++w)
+			m_threads.emplace_back([this, w]() { workerLoop(w); });
+	}
+
+	~CommandScheduler()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_wake.notify_all();
+		for (std::thread& thread : m_threads)
+			thread.join();
+	}
+
+	CommandScheduler(const CommandScheduler&) = delete;
+	CommandScheduler& operator=(const CommandScheduler&) = delete;
+
+	// Run records[0, count) with the same effect as in order; inverses (optional)
+	// receives what Traits::execute returned for each record, by index
+	void run(Context& context, const Record* records, size_t count, Record* inverses = nullptr)
+	{
+		if (count < m_serialThreshold || m_threads.empty())
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				const Record inverse = Traits::execute(context, records[i]);
+				if (inverses)
+					inverses[i] = inverse;
+			}
+			return;
+		}
+
+		buildGraph(records, count);
+
+		m_context = &context;
+		m_records = records;
+		m_inverses = inverses;
+		m_remaining.store(static_cast<uint32_t>(count), std::memory_order_release);
+
+		// Deal the initial roots out round robin
+		unsigned queue = 0;
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			if (m_pending[i].load(std::memory_order_relaxed) == 0)
+			{
+				push(queue, i);
+				queue = (queue + 1) % m_queueCount;
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_generation++;
+		}
+		m_wake.notify_all();
+
+		// The calling thread works too, then waits for stragglers to leave the batch
+		work(0);
+		while (m_active.load(std::memory_order_acquire) != 0)
+			std::this_thread::yield();
+	}
+
+	// Edges in the last batch's graph (for tuning and tests)
+	size_t lastEdgeCount() const { return m_successors.size(); }
+
+private:
+	struct alignas(64) WorkQueue
+	{
+		std::mutex mutex;
+		std::deque<uint32_t> tasks;
+	};
+
+	struct ResourceState
+	{
+		int64_t lastWriter;
+		std::vector<uint32_t> readers;	// since the last write
+	};
+
+	void addEdge(uint32_t from, uint32_t to)
+	{
+		m_edges.push_back(std::make_pair(from, to));
+	}
+
+	void buildGraph(const Record* records, size_t count)
+	{
+		m_edges.clear();
+		for (auto& resource : m_resources)
+		{
+			resource.second.lastWriter = -1;
+			resource.second.readers.clear();
+		}
+
+		// Commands since the last barrier, which the next barrier waits for
+		int64_t lastBarrier = -1;
+		m_sinceBarrier.clear();
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			CommandAccess access;
+			Traits::access(records[i], access);
+
+			if (lastBarrier >= 0)
+				addEdge(static_cast<uint32_t>(lastBarrier), i);
+
+			if (access.overflow)
+			{
+				for (uint32_t before : m_sinceBarrier)
+					addEdge(before, i);
+				m_sinceBarrier.clear();
+				lastBarrier = i;
+				continue;
+			}
+			m_sinceBarrier.push_back(i);
+
+			for (unsigned r = 0; r < access.readCount; ++r)
+			{
+				ResourceState& state = resource(access.reads[r]);
+				if (state.lastWriter >= 0)
+					addEdge(static_cast<uint32_t>(state.lastWriter), i);
+				state.readers.push_back(i);
+			}
+
+			for (unsigned w = 0; w < access.writeCount; ++w)
+			{
+				// The same resource may be listed twice (a swap of a with a): no self edge
+				ResourceState& state = resource(access.writes[w]);
+				if (state.lastWriter >= 0 && state.lastWriter != i)
+					addEdge(static_cast<uint32_t>(state.lastWriter), i);
+				for (uint32_t reader : state.readers)
+				{
+					if (reader != i)
+						addEdge(reader, i);
+				}
+				state.readers.clear();
+				state.lastWriter = i;
+			}
+		}
+
+		// Compressed successor lists, plus a pending-predecessor count per command
+		if (m_pendingCapacity < count)
+		{
+			m_pending.reset(new std::atomic<uint32_t>[count]);
+			m_pendingCapacity = count;
+		}
+		m_successorBegin.assign(count + 1, 0);
+		for (uint32_t i = 0; i < count; ++i)
+			m_pending[i].store(0, std::memory_order_relaxed);
+
+		for (const auto& edge : m_edges)
+		{
+			m_successorBegin[edge.first + 1]++;
+			m_pending[edge.second].fetch_add(1, std::memory_order_relaxed);
+		}
+		for (size_t i = 0; i < count; ++i)
+			m_successorBegin[i + 1] += m_successorBegin[i];
+
+		m_successors.resize(m_edges.size());
+		m_fill.assign(m_successorBegin.begin(), m_successorBegin.end() - 1);
+		for (const auto& edge : m_edges)
+			m_successors[m_fill[edge.first]++] = edge.second;
+	}
+
+	ResourceState& resource(uint32_t id)
+	{
+		auto it = m_resources.find(id);
+		if (it == m_resources.end())
+			it = m_resources.emplace(id, ResourceState{ -1, std::vector<uint32_t>() }).first;
+		return it->second;
+	}
+
+	void workerLoop(unsigned worker)
+	{
+		uint64_t seen = 0;
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wake.wait(lock, [&]() { return m_stop || m_generation != seen; });
+				if (m_stop)
+					return;
+				seen = m_generation;
+			}
+			work(worker);
+		}
+	}
+
+	void work(unsigned worker)
+	{
+		m_active.fetch_add(1, std::memory_order_acq_rel);
+
+		while (m_remaining.load(std::memory_order_acquire) != 0)
+		{
+			uint32_t task;
+			if (pop(worker, task) || steal(worker, task))
+				execute(worker, task);
+			else
+				std::this_thread::yield();
+		}
+
+		m_active.fetch_sub(1, std::memory_order_acq_rel);
+	}
+
+	void execute(unsigned worker, uint32_t task)
+	{
+		const Record inverse = Traits::execute(*m_context, m_records[task]);
+		if (m_inverses)
+			m_inverses[task] = inverse;
+
+		// Release successors whose last predecessor this was; they stay on this
+		// worker's queue, where their data is likely still in cache
+		for (uint32_t s = m_successorBegin[task]; s < m_successorBegin[task + 1]; ++s)
+		{
+			const uint32_t successor = m_successors[s];
+			if (m_pending[successor].fetch_sub(1, std::memory_order_acq_rel) == 1)
+				push(worker, successor);
+		}
+
+		m_remaining.fetch_sub(1, std::memory_order_acq_rel);
+	}
+
+	void push(unsigned worker, uint32_t task)
+	{
+		std::lock_guard<std::mutex> lock(m_queues[worker].mutex);
+		m_queues[worker].tasks.push_back(task);
+	}
+
+	// Owner takes the newest task (LIFO), thieves take the oldest (FIFO)
+	bool pop(unsigned worker, uint32_t& task)
+	{
+		WorkQueue& queue = m_queues[worker];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.tasks.empty())
+			return false;
+		task = queue.tasks.back();
+		queue.tasks.pop_back();
+		return true;
+	}
+
+	bool steal(unsigned worker, uint32_t& task)
+	{
+		for (unsigned offset = 1; offset < m_queueCount; ++offset)
+		{
+			WorkQueue& queue = m_queues[(worker + offset) % m_queueCount];
+			std::unique_lock<std::mutex> lock(queue.mutex, std::try_to_lock);
+			if (!lock.owns_lock() || queue.tasks.empty())
+				continue;
+			task = queue.tasks.front();
+			queue.tasks.pop_front();
+			return true;
+		}
+		return false;
+	}
+
+private:
+	size_t m_serialThreshold;
+
+	// Graph of the current batch
+	std::unordered_map<uint32_t, ResourceState> m_resources;
+	std::vector<std::pair<uint32_t, uint32_t>> m_edges;
+	std::vector<uint32_t> m_successorBegin;
+	std::vector<uint32_t> m_successors;
+	std::vector<uint32_t> m_fill;
+	std::vector<uint32_t> m_sinceBarrier;
+	std::unique_ptr<std::atomic<uint32_t>[]> m_pending;
+	size_t m_pendingCapacity = 0;
+
+	// Pool
+	std::unique_ptr<WorkQueue[]> m_queues;
+	unsigned m_queueCount;
+	std::vector<std::thread> m_threads;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	uint64_t m_generation;
+	bool m_stop;
+	std::atomic<unsigned> m_active;
+	std::atomic<uint32_t> m_remaining;
+
+	// Current batch
+	Context* m_context;
+	const Record* m_records;
+	Record* m_inverses;
+};
+
+// How it's used ???
+namespace command_scheduler
+{
+	void example()
+	{
+		// A server tick: one input command per player, almost no two touch the same player
+		std::vector<Player> players(10000);
+		PlayerCommandBuffer commands;
+		CommandScheduler<PlayerCommandTraits> scheduler;
+
+		for (uint32_t p = 0; p < players.size(); ++p)
+			commands.record(p % 2 ? PlayerCommand::moveUp(p) : PlayerCommand::moveRight(p));
+
+		// Two commands on player 0: these keep their order, the rest run in parallel
+		commands.setCoalescing(false);
+		commands.record(PlayerCommand::setPosition(0, 5, 5));
+		commands.record(PlayerCommand::moveUp(0));
+
+		commands.execute(players, scheduler);
+		players[0].update();	// (5, 6)
+
+		// Undo still works: inverses were recorded per command
+		commands.undo(players);
+		players[0].update();	// (0, 0)
+	}
+}
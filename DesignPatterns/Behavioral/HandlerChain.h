@@ -0,0 +1,209 @@
+/* Compiled chain of responsibility
+ *
+ * A linked chain (ChainOfResponsibility.h) costs a pointer chase and a virtual
+ * call per hop for every request. With 30+ input handlers and one walk per input
+ * event that adds up, although most handlers ignore most requests.
+ *
+ * HandlerChain flattens the chain into a contiguous array, and for a known key
+ * range (e.g. key codes) precomputes a route per key: the handlers that act on
+ * that key, up to the one that stops it. Handlers that would just pass are left
+ * out of the route, so a typical dispatch is one table lookup and one process().
+ *
+ * 		- static handlers (isStatic() overridden to true) are classified once per
+ * 		  key at compile()
+ * 		- all other handlers stay in every route and are classified at dispatch
+ * 		- keys outside the compiled range walk the flat array instead
+ *
+ * Checklist:
+ * 1. add() the handlers in chain order, or build from the head of a linked chain
+ * 2. compile(minKey, maxKey) for the key range that matters
+ * 3. dispatch() requests, one at a time or a whole span in batch mode
+ * 4. compile() again after adding handlers or when static handlers change
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "ChainOfResponsibility.h"
+
+class HandlerChain
+{
+public:
+	HandlerChain() : m_minKey(0), m_keyCount(0) { }
+
+	// [1] From an existing linked chain, following the next pointers
+	explicit HandlerChain(HandlerBase* head) : HandlerChain()
+	{
+		for (HandlerBase* handler = head; handler; handler = handler->getNext())
+			m_handlers.push_back(handler);
+	}
+
+	// Handlers are not owned; adding invalidates the compiled table
+	HandlerChain& add(HandlerBase* handler)
+	{
+		m_handlers.push_back(handler);
+		m_keyCount = 0;
+		return *this;
+	}
+
+	// [2] Route for every key in [minKey, maxKey]
+	void compile(int minKey, int maxKey)
+	{
+		m_routes.clear();
+		m_routeBegin.clear();
+		m_minKey = minKey;
+		m_keyCount = maxKey >= minKey ? static_cast<uint32_t>(static_cast<int64_t>(maxKey) - minKey + 1) : 0;
+
+		m_routeBegin.reserve(m_keyCount + 1);
+		for (uint32_t k = 0; k < m_keyCount; ++k)
+		{
+			m_routeBegin.push_back(static_cast<uint32_t>(m_routes.size()));
+
+			const int key = static_cast<int>(m_minKey + static_cast<int64_t>(k));
+			for (uint32_t h = 0; h < m_handlers.size(); ++h)
+			{
+				if (!m_handlers[h]->isStatic())
+				{
+					m_routes.push_back(entry(h, DYNAMIC));
+					continue;
+				}
+
+				const unsigned action = m_handlers[h]->classify(key);
+				if (action == HANDLER_PASS)
+					continue;
+				m_routes.push_back(entry(h, action));
+				if (action & HANDLER_STOP)
+					break;
+			}
+		}
+		m_routeBegin.push_back(static_cast<uint32_t>(m_routes.size()));
+	}
+
+	// [3]
+	void dispatch(int request)
+	{
+		const uint32_t k = static_cast<uint32_t>(static_cast<int64_t>(request) - m_minKey);
+		if (k >= m_keyCount)
+		{
+			walk(request);
+			return;
+		}
+
+		for (uint32_t r = m_routeBegin[k]; r < m_routeBegin[k + 1]; ++r)
+		{
+			HandlerBase* handler = m_handlers[m_routes[r] >> 2];
+			unsigned action = m_routes[r] & 3;
+			if (action == DYNAMIC)
+				action = handler->classify(request);
+
+			if (action & HANDLER_ACT)
+				handler->process(request);
+			if (action & HANDLER_STOP)
+				return;
+		}
+	}
+
+	// Batch mode: every handler gets the span once (see HandlerBase::handleBatch)
+	void dispatch(const int* requests, size_t count)
+	{
+		m_unconsumed.resize(handler_batch::wordCount(count));
+		for (size_t w = 0; w < m_unconsumed.size(); ++w)
+			m_unconsumed[w] = handler_batch::fullMask(count, w);
+
+		for (HandlerBase* handler : m_handlers)
+		{
+			if (!count || !handler->handleBatch(requests, count, m_unconsumed.data()))
+				return;
+		}
+	}
+
+	size_t handlerCount() const { return m_handlers.size(); }
+	bool isCompiled(int request) const
+	{
+		return static_cast<uint64_t>(static_cast<int64_t>(request) - m_minKey) < m_keyCount;
+	}
+
+private:
+	// Route entries pack the handler index and its precomputed action; the
+	// otherwise unused PASS value marks "classify at dispatch"
+	static const unsigned DYNAMIC = HANDLER_PASS;
+
+	static uint32_t entry(uint32_t handler, unsigned action) { return handler << 2 | action; }
+
+	// Uncompiled keys: same as the linked chain, without the pointer chase
+	void walk(int request)
+	{
+		for (HandlerBase* handler : m_handlers)
+		{
+			const unsigned action = handler->classify(request);
+			if (action & HANDLER_ACT)
+				handler->process(request);
+			if (action & HANDLER_STOP)
+				return;
+		}
+	}
+
+private:
+	std::vector<HandlerBase*> m_handlers;
+
+	// Routes of all keys back to back; key k's route is [m_routeBegin[k], m_routeBegin[k + 1])
+	std::vector<uint32_t> m_routes;
+	std::vector<uint32_t> m_routeBegin;
+	int m_minKey;
+	uint32_t m_keyCount;
+
+	// Batch mode mask, kept to avoid allocating per batch
+	std::vector<uint64_t> m_unconsumed;
+};
+
+// How it's used ???
+namespace handler_chain
+{
+	// A handler whose decision depends on its own state stays dynamic (the default)
+	class MuteHandler : public HandlerBase
+	{
+	public:
+		MuteHandler() : m_muted(false) { }
+		void setMuted(bool muted) { m_muted = muted; }
+
+		HandlerAction classify(int /*request*/) const override { return m_muted ? HANDLER_DROP : HANDLER_PASS; }
+		void process(int /*request*/) override { }
+
+	private:
+		bool m_muted;
+	};
+
+	void example()
+	{
+		Handler1 handler1;
+		Handler2 handler2;
+		Handler3 handler3;
+		MuteHandler mute;
+
+		// The linked chain still works as before
+		mute.setNext(&handler1);
+		handler1.setNext(&handler2);
+		handler2.setNext(&handler3);
+		mute.handle(12);
+
+		// Flattened and compiled for a key code range
+		HandlerChain chain(&mute);
+		chain.compile(0, 255);
+
+		chain.dispatch(0);		// Handler 1, Handler 2
+		chain.dispatch(13);		// Handler 3
+		chain.dispatch(3);		// swallowed by Handler 3, nothing printed
+		chain.dispatch(1000);	// outside the table: walks the handlers, Handler 2
+
+		mute.setMuted(true);
+		chain.dispatch(12);		// nothing: the dynamic handler is asked every time
+		mute.setMuted(false);
+
+		// A frame's worth of input events in one go
+		std::vector<int> events;
+		for (int i = 0; i < 10; ++i)
+			events.push_back(i * 3);
+		chain.dispatch(events.data(), events.size());	// 0: Handler 1; evens: Handler 2; 15, 21, 27: Handler 3
+	}
+}
@@ -24,13 +24,20 @@
  * - https://sourcemaking.com/design_patterns/memento
  * - https://sourcemaking.com/design_patterns/memento/cpp/1
  * - https://github.com/kamranahmedse/design-patterns-for-humans#-memento
+ *
+ * Full copies per save are fine for a textbox; for multi-MB states saved every
+ * frame see SnapshotHistory.h (delta-encoded, copy-on-write snapshots).
  * 
  */
 
 #pragma once
 
 #include <iostream>
+#include <memory>
+#include <stdint.h>
+#include <string.h>
 #include <string>
+#include <vector>
 
 // Suppose we have an interactive textbox
 // [1] Textbox will be the originator since it has the internal states and data
@@ -50,6 +57,30 @@ public:
 	, m_text("")
 	{
 	}
+
+	// Flat binary form for a history store (MementoStore.h): four int32, then the text
+	void serialize(std::vector<char>& bytes) const
+	{
+		const int32_t fields[4] = { m_width, m_height, m_x, m_y };
+		bytes.resize(sizeof(fields) + m_text.size());
+		memcpy(bytes.data(), fields, sizeof(fields));
+		memcpy(bytes.data() + sizeof(fields), m_text.data(), m_text.size());
+	}
+
+	bool deserialize(const char* data, size_t size)
+	{
+		int32_t fields[4];
+		if (size < sizeof(fields))
+			return false;
+
+		memcpy(fields, data, sizeof(fields));
+		m_width = fields[0];
+		m_height = fields[1];
+		m_x = fields[2];
+		m_y = fields[3];
+		m_text.assign(data + sizeof(fields), size - sizeof(fields));
+		return true;
+	}
 	
 private:
 	int m_width;
@@ -145,7 +176,7 @@ class Window
 {
 public:
 
-	Window() { }
+	Window() : m_textbox(nullptr) { }
 	void setTextbox(Textbox* textbox) { m_textbox = textbox; }
 
 	// Suppose we have these two handlers to call
@@ -156,7 +187,8 @@ public:
 		// Check that we have the necessity to save state
 		if (m_textbox->getChanged())
 		{
-			m_textboxMemento = m_textbox->saveState();
+			// The previous memento is freed here, not leaked
+			m_textboxMemento.reset(m_textbox->saveState());
 			std::cout << "State saved!\n";
 		}
 		else
@@ -170,7 +202,7 @@ public:
 	{
 		if (m_textboxMemento)
 		{
-			m_textbox->loadState(m_textboxMemento, forceLoad);
+			m_textbox->loadState(m_textboxMemento.get(), forceLoad);
 			std::cout << "State loaded!\n";
 		}
 		else
@@ -183,7 +215,7 @@ public:
 
 private:
 	Textbox* m_textbox;
-	TextboxMemento* m_textboxMemento;
+	std::unique_ptr<TextboxMemento> m_textboxMemento;
 };
 
 // How to use it ???
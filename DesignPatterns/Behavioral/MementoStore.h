@@ -0,0 +1,802 @@
+/* Memento history store: deep undo and crash-recovery checkpoints
+ *
+ * A caretaker holding one memento pointer (see Window in Memento.h) can undo a
+ * single step, and the history is gone when the process exits. MementoStore
+ * keeps every snapshot, as serialized bytes, in three tiers:
+ *
+ * 		- hot:  the newest few snapshots, raw, so recent restores are instant
+ * 		- warm: older snapshots, compressed on a background thread with a small
+ * 		        LZ codec (byte oriented, LZ4 style: fast rather than tight)
+ * 		- cold: once warm entries exceed the memory budget, the oldest are
+ * 		        appended to a memory-mapped spill file and dropped from memory
+ *
+ * The spill file is an append-only log of checksummed records, so opening the
+ * same path again recovers every snapshot that made it to disk. checkpoint()
+ * writes out everything not yet on disk, for crash recovery points.
+ *
+ * Checklist:
+ * 1. Give the originator's memento a serialize / deserialize pair
+ * 2. push() the serialized memento at every save point; keep the returned id
+ * 3. load(id) and deserialize to restore
+ * 4. checkpoint() when a crash-safe point is needed
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Memento.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Byte oriented LZ77 codec in the LZ4 style: a token byte holds the literal and
+// match lengths (4 bits each, 255-run extended), followed by literals and a
+// 16-bit match offset. One hash probe per position, no entropy coding.
+struct LzCodec
+{
+	static const size_t MIN_MATCH = 4;
+	static const size_t HASH_BITS = 12;
+	static const size_t MAX_OFFSET = 65535;
+	// Trailing bytes always go out as literals, so a match never reads past the end
+	static const size_t LAST_LITERALS = 5;
+
+	static size_t maxCompressedSize(size_t size) { return size + size / 255 + 16; }
+
+	static void compress(const char* source, size_t size, std::vector<char>& out)
+	{
+		out.resize(maxCompressedSize(size));
+		char* op = out.data();
+
+		const unsigned char* in = reinterpret_cast<const unsigned char*>(source);
+		int32_t table[1 << HASH_BITS];
+		for (int32_t& entry : table)
+			entry = -1;
+
+		size_t anchor = 0;
+		size_t i = 0;
+		// Skip ahead faster the longer nothing matches (incompressible data)
+		size_t misses = 0;
+		const size_t matchLimit = size > LAST_LITERALS + MIN_MATCH ? size - LAST_LITERALS - MIN_MATCH : 0;
+		while (i < matchLimit)
+		{
+			uint32_t sequence;
+			memcpy(&sequence, in + i, 4);
+			const uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+			const int32_t candidate = table[hash];
+			table[hash] = static_cast<int32_t>(i);
+
+			uint32_t previous;
+			if (candidate < 0 || i - candidate > MAX_OFFSET || (memcpy(&previous, in + candidate, 4), previous != sequence))
+			{
+				i += 1 + (misses++ >> 5);
+				continue;
+			}
+			misses = 0;
+
+			// Extend the match, leaving LAST_LITERALS bytes for the tail
+			size_t length = MIN_MATCH;
+			while (i + length < size - LAST_LITERALS && in[candidate + length] == in[i + length])
+				++length;
+
+			op = writeSequence(op, in + anchor, i - anchor, static_cast<uint32_t>(i - candidate), length);
+			i += length;
+			anchor = i;
+		}
+
+		// Final literals, no match
+		op = writeSequence(op, in + anchor, size - anchor, 0, 0);
+		out.resize(op - out.data());
+	}
+
+	// false on corrupt input; never writes outside [destination, destination + size)
+	static bool decompress(const char* source, size_t sourceSize, char* destination, size_t size)
+	{
+		const unsigned char* ip = reinterpret_cast<const unsigned char*>(source);
+		const unsigned char* end = ip + sourceSize;
+		char* op = destination;
+		char* const opEnd = destination + size;
+
+		while (ip < end)
+		{
+			const unsigned token = *ip++;
+
+			size_t literals = token >> 4;
+			if (literals == 15 && !readLength(ip, end, literals))
+				return false;
+			if (literals > static_cast<size_t>(end - ip) || literals > static_cast<size_t>(opEnd - op))
+				return false;
+			if (literals)
+				memcpy(op, ip, literals);
+			ip += literals;
+			op += literals;
+
+			// The last sequence has no match
+			if (ip == end)
+				break;
+
+			if (end - ip < 2)
+				return false;
+			const size_t offset = ip[0] | (ip[1] << 8);
+			ip += 2;
+			if (offset == 0 || offset > static_cast<size_t>(op - destination))
+				return false;
+
+			size_t length = token & 15;
+			if (length == 15 && !readLength(ip, end, length))
+				return false;
+			length += MIN_MATCH;
+			if (length > static_cast<size_t>(opEnd - op))
+				return false;
+
+			// Byte by byte: source and destination may overlap (runs)
+			const char* match = op - offset;
+			for (size_t b = 0; b < length; ++b)
+				op[b] = match[b];
+			op += length;
+		}
+
+		return op == opEnd;
+	}
+
+private:
+	static char* writeLength(char* op, size_t length)
+	{
+		for (; length >= 255; length -= 255)
+			*op++ = static_cast<char>(255);
+		*op++ = static_cast<char>(length);
+		return op;
+	}
+
+	static bool readLength(const unsigned char*& ip, const unsigned char* end, size_t& length)
+	{
+		unsigned char byte;
+		do
+		{
+			if (ip == end)
+				return false;
+			byte = *ip++;
+			length += byte;
+		} while (byte == 255);
+		return true;
+	}
+
+	static char* writeSequence(char* op, const unsigned char* literals, size_t literalCount, uint32_t offset, size_t matchLength)
+	{
+		const size_t matchCode = matchLength ? matchLength - MIN_MATCH : 0;
+		char* token = op++;
+		*token = static_cast<char>(((literalCount < 15 ? literalCount : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+
+		if (literalCount >= 15)
+			op = writeLength(op, literalCount - 15);
+		if (literalCount)
+			memcpy(op, literals, literalCount);
+		op += literalCount;
+
+		if (matchLength)
+		{
+			*op++ = static_cast<char>(offset & 0xFF);
+			*op++ = static_cast<char>(offset >> 8);
+			if (matchCode >= 15)
+				op = writeLength(op, matchCode - 15);
+		}
+		return op;
+	}
+};
+
+// Append-only log of compressed snapshots in a memory-mapped file.
+// Layout: SpillHeader, then records (SpillRecord + payload, 8 byte aligned).
+class MementoSpillFile
+{
+public:
+	static const uint32_t FILE_MAGIC = 0x4D454D4F;	// "MEMO"
+	static const uint32_t RECORD_MAGIC = 0x52454353;	// "SCER"
+	static const uint32_t VERSION = 1;
+
+	struct SpillHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+	};
+
+	struct SpillRecord
+	{
+		uint32_t magic;
+		uint32_t rawSize;
+		uint32_t compressedSize;
+		uint32_t checksum;
+		uint64_t id;
+	};
+
+	MementoSpillFile()
+		: m_mapping(nullptr)
+		, m_capacity(0)
+		, m_end(0)
+#ifdef _WIN32
+		, m_file(INVALID_HANDLE_VALUE)
+		, m_mappingHandle(nullptr)
+#else
+		, m_fd(-1)
+#endif
+	{
+	}
+
+	~MementoSpillFile() { close(); }
+
+	MementoSpillFile(const MementoSpillFile&) = delete;
+	MementoSpillFile& operator=(const MementoSpillFile&) = delete;
+
+	// Open or create; visit(record, payloadOffset) is called for every intact
+	// record already in the file. A torn record at the end (crash) is ignored.
+	template <class Visit>
+	bool open(const std::string& path, Visit visit)
+	{
+		close();
+
+#ifdef _WIN32
+		m_file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (m_file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(m_file, &size))
+		{
+			close();
+			return false;
+		}
+		const uint64_t fileSize = static_cast<uint64_t>(size.QuadPart);
+#else
+		m_fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+		if (m_fd < 0)
+			return false;
+
+		struct stat info;
+		if (fstat(m_fd, &info) != 0)
+		{
+			close();
+			return false;
+		}
+		const uint64_t fileSize = static_cast<uint64_t>(info.st_size);
+#endif
+
+		if (!map(fileSize > INITIAL_CAPACITY ? fileSize : INITIAL_CAPACITY))
+		{
+			close();
+			return false;
+		}
+
+		SpillHeader* header = reinterpret_cast<SpillHeader*>(m_mapping);
+		if (fileSize < sizeof(SpillHeader) || header->magic != FILE_MAGIC || header->version != VERSION)
+		{
+			// New (or foreign) file: start an empty log
+			header->magic = FILE_MAGIC;
+			header->version = VERSION;
+			m_end = align(sizeof(SpillHeader));
+			memset(m_mapping + m_end, 0, m_capacity - m_end);
+			return true;
+		}
+
+		m_end = align(sizeof(SpillHeader));
+		while (m_end + sizeof(SpillRecord) <= m_capacity)
+		{
+			const SpillRecord* record = reinterpret_cast<const SpillRecord*>(m_mapping + m_end);
+			const uint64_t payload = m_end + sizeof(SpillRecord);
+			if (record->magic != RECORD_MAGIC || payload + record->compressedSize > m_capacity
+				|| checksum(m_mapping + payload, record->compressedSize) != record->checksum)
+				break;
+
+			visit(*record, payload);
+			m_end = align(payload + record->compressedSize);
+		}
+		return true;
+	}
+
+	bool isOpen() const { return m_mapping != nullptr; }
+
+	// Returns the payload offset, or 0 if the file could not grow
+	uint64_t append(uint64_t id, uint32_t rawSize, const char* data, uint32_t size)
+	{
+		const uint64_t recordEnd = align(m_end + sizeof(SpillRecord) + size);
+		if (recordEnd > m_capacity)
+		{
+			uint64_t capacity = m_capacity * 2;
+			while (capacity < recordEnd)
+				capacity *= 2;
+			if (!map(capacity))
+				return 0;
+		}
+
+		// Payload first, record header last: a crash in between leaves no valid record
+		const uint64_t payload = m_end + sizeof(SpillRecord);
+		memcpy(m_mapping + payload, data, size);
+
+		SpillRecord record;
+		record.magic = RECORD_MAGIC;
+		record.rawSize = rawSize;
+		record.compressedSize = size;
+		record.checksum = checksum(data, size);
+		record.id = id;
+		memcpy(m_mapping + m_end, &record, sizeof(record));
+
+		m_end = recordEnd;
+		return payload;
+	}
+
+	const char* at(uint64_t offset) const { return m_mapping + offset; }
+	uint64_t bytesUsed() const { return m_end; }
+
+	void flush()
+	{
+		if (!m_mapping)
+			return;
+#ifdef _WIN32
+		FlushViewOfFile(m_mapping, static_cast<SIZE_T>(m_end));
+		FlushFileBuffers(m_file);
+#else
+		msync(m_mapping, static_cast<size_t>(m_end), MS_SYNC);
+#endif
+	}
+
+	void close()
+	{
+		unmap();
+#ifdef _WIN32
+		if (m_file != INVALID_HANDLE_VALUE)
+			CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+#else
+		if (m_fd >= 0)
+			::close(m_fd);
+		m_fd = -1;
+#endif
+		m_capacity = 0;
+		m_end = 0;
+	}
+
+private:
+	static const uint64_t INITIAL_CAPACITY = 1 << 20;
+
+	static uint64_t align(uint64_t offset) { return (offset + 7) & ~7ULL; }
+
+	// FNV-1a, enough to spot a torn write
+	static uint32_t checksum(const char* data, size_t size)
+	{
+		uint32_t hash = 2166136261u;
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= static_cast<unsigned char>(data[i]);
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+	// (Re)map the whole file at the given size, growing it if needed. The new
+	// view is created before the old one goes, so a failed grow keeps the old
+	// mapping (and capacity) usable.
+	bool map(uint64_t capacity)
+	{
+#ifdef _WIN32
+		HANDLE mappingHandle = CreateFileMappingA(m_file, nullptr, PAGE_READWRITE, static_cast<DWORD>(capacity >> 32), static_cast<DWORD>(capacity), nullptr);
+		if (!mappingHandle)
+			return false;
+
+		char* mapping = static_cast<char*>(MapViewOfFile(mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+		if (!mapping)
+		{
+			CloseHandle(mappingHandle);
+			return false;
+		}
+
+		unmap();
+		m_mappingHandle = mappingHandle;
+#else
+		if (ftruncate(m_fd, static_cast<off_t>(capacity)) != 0)
+			return false;
+
+		void* data = mmap(nullptr, static_cast<size_t>(capacity), PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+		if (data == MAP_FAILED)
+			return false;
+		char* mapping = static_cast<char*>(data);
+
+		unmap();
+#endif
+
+		m_mapping = mapping;
+		m_capacity = capacity;
+		return true;
+	}
+
+	void unmap()
+	{
+		if (!m_mapping)
+			return;
+#ifdef _WIN32
+		UnmapViewOfFile(m_mapping);
+		CloseHandle(m_mappingHandle);
+		m_mappingHandle = nullptr;
+#else
+		munmap(m_mapping, static_cast<size_t>(m_capacity));
+#endif
+		m_mapping = nullptr;
+	}
+
+private:
+	char* m_mapping;
+	uint64_t m_capacity;
+	uint64_t m_end;
+#ifdef _WIN32
+	HANDLE m_file;
+	HANDLE m_mappingHandle;
+#else
+	int m_fd;
+#endif
+};
+
+struct MementoStoreOptions
+{
+	// Newest snapshots kept raw in memory
+	unsigned hotEntries = 8;
+	// Compressed bytes kept in memory before the oldest spill to disk
+	size_t memoryBudget = 64 * 1024 * 1024;
+	// Empty: no spill file, nothing survives the process, warm entries stay in memory
+	std::string spillPath;
+};
+
+struct MementoStoreStats
+{
+	size_t hot = 0;
+	size_t warm = 0;
+	size_t cold = 0;
+
+	uint64_t hotBytes = 0;
+	uint64_t warmBytes = 0;
+	uint64_t fileBytes = 0;
+
+	// Over every snapshot compressed so far
+	uint64_t rawBytesCompressed = 0;
+	uint64_t compressedBytes = 0;
+
+	double compressionRatio() const { return compressedBytes ? static_cast<double>(rawBytesCompressed) / compressedBytes : 0.0; }
+
+	void print(std::ostream& out) const
+	{
+		out << "mementos: " << hot << " hot (" << hotBytes << " B), " << warm << " warm (" << warmBytes << " B), "
+			<< cold << " cold, spill file " << fileBytes << " B, compression " << compressionRatio() << ":1\n";
+	}
+};
+
+class MementoStore
+{
+public:
+	explicit MementoStore(const MementoStoreOptions& options = MementoStoreOptions())
+		: m_options(options)
+		, m_nextId(0)
+		, m_hotBytes(0)
+		, m_warmBytes(0)
+		, m_rawBytesCompressed(0)
+		, m_compressedBytes(0)
+		, m_stop(false)
+	{
+		// Recover whatever a previous run left in the spill file
+		if (!m_options.spillPath.empty())
+		{
+			m_file.open(m_options.spillPath, [this](const MementoSpillFile::SpillRecord& record, uint64_t payload) {
+				Entry& entry = m_entries[record.id];
+				entry.state = COLD;
+				entry.rawSize = record.rawSize;
+				entry.compressedSize = record.compressedSize;
+				entry.fileOffset = payload;
+				if (record.id >= m_nextId)
+					m_nextId = record.id + 1;
+			});
+		}
+
+		m_worker = std::thread([this]() { run(); });
+	}
+
+	~MementoStore()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_wake.notify_one();
+		m_worker.join();
+		m_file.flush();
+	}
+
+	MementoStore(const MementoStore&) = delete;
+	MementoStore& operator=(const MementoStore&) = delete;
+
+	// [2] Takes a serialized memento; returns its id
+	uint64_t push(std::vector<char>&& bytes)
+	{
+		uint64_t id;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			id = m_nextId++;
+
+			Entry& entry = m_entries[id];
+			entry.state = HOT;
+			entry.rawSize = static_cast<uint32_t>(bytes.size());
+			entry.raw = std::make_shared<const std::vector<char>>(std::move(bytes));
+			m_hotBytes += entry.rawSize;
+			m_hotQueue.push_back(id);
+		}
+		m_wake.notify_one();
+		return id;
+	}
+
+	uint64_t push(const void* data, size_t size)
+	{
+		return push(std::vector<char>(static_cast<const char*>(data), static_cast<const char*>(data) + size));
+	}
+
+	// [3] Raw bytes of a snapshot, from whichever tier holds it
+	bool load(uint64_t id, std::vector<char>& out) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_entries.find(id);
+		if (it == m_entries.end())
+			return false;
+
+		const Entry& entry = it->second;
+		switch (entry.state)
+		{
+		case HOT:
+			out = *entry.raw;
+			return true;
+		case WARM:
+			out.resize(entry.rawSize);
+			return LzCodec::decompress(entry.compressed.data(), entry.compressed.size(), out.data(), out.size());
+		case COLD:
+			out.resize(entry.rawSize);
+			return LzCodec::decompress(m_file.at(entry.fileOffset), entry.compressedSize, out.data(), out.size());
+		}
+		return false;
+	}
+
+	bool contains(uint64_t id) const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_entries.count(id) != 0;
+	}
+
+	// Id of the newest snapshot, or ~0 when empty
+	uint64_t latest() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_entries.empty() ? ~0ULL : m_entries.rbegin()->first;
+	}
+
+	size_t size() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_entries.size();
+	}
+
+	// [4] Make every snapshot so far durable; in-memory tiers are left as they are
+	bool checkpoint()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_file.isOpen())
+			return false;
+
+		std::vector<char> compressed;
+		for (auto& it : m_entries)
+		{
+			Entry& entry = it.second;
+			if (entry.fileOffset)
+				continue;
+
+			// A failed append leaves the entry as it was (hot or warm, not on disk)
+			uint64_t offset;
+			if (entry.state == HOT)
+			{
+				LzCodec::compress(entry.raw->data(), entry.raw->size(), compressed);
+				offset = m_file.append(it.first, entry.rawSize, compressed.data(), static_cast<uint32_t>(compressed.size()));
+			}
+			else
+			{
+				offset = m_file.append(it.first, entry.rawSize, entry.compressed.data(), entry.compressedSize);
+			}
+
+			if (!offset)
+				return false;
+			entry.fileOffset = offset;
+			if (entry.state == HOT)
+				entry.compressedSize = static_cast<uint32_t>(compressed.size());
+		}
+
+		m_file.flush();
+		return true;
+	}
+
+	MementoStoreStats stats() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		MementoStoreStats stats;
+		for (const auto& it : m_entries)
+		{
+			if (it.second.state == HOT)
+				stats.hot++;
+			else if (it.second.state == WARM)
+				stats.warm++;
+			else
+				stats.cold++;
+		}
+		stats.hotBytes = m_hotBytes;
+		stats.warmBytes = m_warmBytes;
+		stats.fileBytes = m_file.isOpen() ? m_file.bytesUsed() : 0;
+		stats.rawBytesCompressed = m_rawBytesCompressed;
+		stats.compressedBytes = m_compressedBytes;
+		return stats;
+	}
+
+private:
+	enum State
+	{
+		HOT,
+		WARM,
+		COLD
+	};
+
+	struct Entry
+	{
+		State state = HOT;
+		uint32_t rawSize = 0;
+		uint32_t compressedSize = 0;
+		// Payload offset in the spill file, 0 while not on disk
+		uint64_t fileOffset = 0;
+
+		// Shared so the worker can compress it without holding the lock
+		std::shared_ptr<const std::vector<char>> raw;
+		std::vector<char> compressed;
+	};
+
+	// Background: compress snapshots that fall out of the hot window, then spill
+	// the oldest compressed ones while over the memory budget
+	void run()
+	{
+		std::vector<char> compressed;
+		std::unique_lock<std::mutex> lock(m_mutex);
+		for (;;)
+		{
+			m_wake.wait(lock, [this]() { return m_stop || m_hotQueue.size() > m_options.hotEntries; });
+			if (m_stop)
+				return;
+
+			const uint64_t id = m_hotQueue.front();
+			m_hotQueue.pop_front();
+
+			auto it = m_entries.find(id);
+			if (it == m_entries.end() || it->second.state != HOT)
+				continue;
+			std::shared_ptr<const std::vector<char>> raw = it->second.raw;
+
+			lock.unlock();
+			LzCodec::compress(raw->data(), raw->size(), compressed);
+			lock.lock();
+
+			// Entries are never erased, but look it up again after unlocking anyway
+			it = m_entries.find(id);
+			if (it == m_entries.end() || it->second.state != HOT)
+				continue;
+
+			Entry& entry = it->second;
+			entry.state = WARM;
+			entry.compressedSize = static_cast<uint32_t>(compressed.size());
+			entry.compressed.assign(compressed.begin(), compressed.end());
+			entry.raw.reset();
+
+			m_hotBytes -= entry.rawSize;
+			m_warmBytes += entry.compressedSize;
+			m_rawBytesCompressed += entry.rawSize;
+			m_compressedBytes += entry.compressedSize;
+			m_warmQueue.push_back(id);
+
+			spillLocked();
+		}
+	}
+
+	void spillLocked()
+	{
+		if (!m_file.isOpen())
+			return;
+
+		while (m_warmBytes > m_options.memoryBudget && !m_warmQueue.empty())
+		{
+			Entry& entry = m_entries[m_warmQueue.front()];
+			if (!entry.fileOffset)
+			{
+				const uint64_t offset = m_file.append(m_warmQueue.front(), entry.rawSize, entry.compressed.data(), entry.compressedSize);
+				if (!offset)
+					return;	// disk full: keep it warm, in memory
+				entry.fileOffset = offset;
+			}
+
+			m_warmBytes -= entry.compressedSize;
+			std::vector<char>().swap(entry.compressed);
+			entry.state = COLD;
+			m_warmQueue.pop_front();
+		}
+	}
+
+private:
+	MementoStoreOptions m_options;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::map<uint64_t, Entry> m_entries;
+	std::deque<uint64_t> m_hotQueue;
+	std::deque<uint64_t> m_warmQueue;
+	uint64_t m_nextId;
+
+	uint64_t m_hotBytes;
+	uint64_t m_warmBytes;
+	uint64_t m_rawBytesCompressed;
+	uint64_t m_compressedBytes;
+
+	MementoSpillFile m_file;
+	std::thread m_worker;
+	bool m_stop;
+};
+
+// How it's used ???
+namespace memento_store
+{
+	void example()
+	{
+		MementoStoreOptions options;
+		options.hotEntries = 4;
+		options.memoryBudget = 1024;
+		options.spillPath = "textbox_history.bin";
+
+		std::vector<uint64_t> history;
+		{
+			MementoStore store(options);
+			Textbox textbox(0, 0, 100, 100);
+
+			// [2] Every edit is a save point
+			for (int edit = 0; edit < 100; ++edit)
+			{
+				textbox.addChar(static_cast<char>('a' + edit % 26));
+				std::unique_ptr<TextboxMemento> memento(textbox.saveState());
+				std::vector<char> bytes;
+				memento->serialize(bytes);
+				history.push_back(store.push(std::move(bytes)));
+			}
+
+			// [4] Crash-safe point
+			store.checkpoint();
+
+			// [3] Undo 50 steps: an older snapshot, maybe from disk
+			std::vector<char> bytes;
+			TextboxMemento memento;
+			if (store.load(history[49], bytes) && memento.deserialize(bytes.data(), bytes.size()))
+				textbox.loadState(&memento, true);
+			textbox.display();
+
+			store.stats().print(std::cout);
+		}
+
+		// Next run: the history is still there
+		MementoStore recovered(options);
+		std::cout << "Recovered " << recovered.size() << " snapshots\n";
+	}
+}
@@ -15,10 +15,14 @@
  *    The observers may "pull" information from subject
  * 
  * Source: https://sourcemaking.com/design_patterns/observer
+ *
+ * For many events per frame see EventBus.h: typed events, batched delivery and
+ * O(1) unsubscription instead of one virtual call per event per observer.
  */
 
 #pragma once
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -31,16 +35,11 @@ class Subject;
 class Observer
 {
 public:
-	Observer(Subject *subject)
-	{
-		m_subject = subject;
-
-		// [6] Observers register themselves
-		m_subject->registerObserver(this);
-	}
+	// Defined after Subject, which is still incomplete here
+	Observer(Subject *subject);
 
 	// Unregister when observer is destroyed so subject don't access invalid memory
-	~Observer() { m_subject->unregisterObserver(this); }
+	virtual ~Observer();
 
 	// Update is up to the derived class
 	virtual void update(int code) = 0;
@@ -78,11 +77,10 @@ public:
 	void registerObserver(Observer* observer) { m_observers.push_back(observer); }
 	void unregisterObserver(Observer* observer)
 	{
-		for (std::vector<Observer *>::iterator observerIter = m_observers.begin(); observerIter != m_observers.end(); observerIter++)
-		{
-			if (*observerIter == observer)
-				m_observers.erase(observerIter);
-		}
+		// !!! Erasing inside an iterator loop invalidates the iterator; find, then erase once
+		std::vector<Observer *>::iterator observerIter = std::find(m_observers.begin(), m_observers.end(), observer);
+		if (observerIter != m_observers.end())
+			m_observers.erase(observerIter);
 	}
 
 private:
@@ -103,6 +101,19 @@ private:
 	std::vector<Observer*> m_observers;
 };
 
+inline Observer::Observer(Subject *subject)
+{
+	m_subject = subject;
+
+	// [6] Observers register themselves
+	m_subject->registerObserver(this);
+}
+
+inline Observer::~Observer()
+{
+	m_subject->unregisterObserver(this);
+}
+
 // [1] Observer derived classes
 class MessageObserver : public Observer
 {
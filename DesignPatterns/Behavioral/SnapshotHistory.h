@@ -0,0 +1,280 @@
+/* Delta-encoded mementos for large states (rollback netcode, editor documents)
+ *
+ * A classic memento (see Memento.h) copies the whole state on every save. For a
+ * state of tens of MB saved every frame that is far too much copying. Here the
+ * live state is one contiguous buffer split into fixed size chunks, and the
+ * history keeps only what changed:
+ *
+ * 		- capture() is O(1): it just opens a new snapshot
+ * 		- the first write to a chunk after a capture copies that chunk's old bytes
+ * 		  (its "before image") into the latest snapshot: copy-on-write at chunk
+ * 		  granularity, everything unchanged is never copied
+ * 		- restore(id) walks back from the newest snapshot applying before images,
+ * 		  so it costs only what changed since that snapshot
+ * 		- snapshots live in a ring; when it is full the oldest one is dropped and
+ * 		  its chunk buffers are recycled, so steady-state frames do not allocate
+ *
+ * Checklist:
+ * 1. Keep the state in a SnapshotHistory (data() for reads)
+ * 2. Mutate ONLY through write() / writeAs() so changes are tracked
+ * 3. capture() at every save point (e.g. once per simulation frame)
+ * 4. restore(id) to roll back; snapshots newer than id are discarded
+ */
+
+#pragma once
+
+#include <iostream>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+class SnapshotHistory
+{
+public:
+	static const uint64_t INVALID_SNAPSHOT = ~0ULL;
+
+	// capacity: how many snapshots are kept; chunkSize: copy-on-write granularity
+	SnapshotHistory(size_t stateSize, unsigned capacity = 64, size_t chunkSize = 4096)
+		: m_state(stateSize, 0)
+		, m_chunkSize(chunkSize ? chunkSize : 4096)
+		, m_savedEpoch((stateSize + m_chunkSize - 1) / m_chunkSize, 0)
+		, m_epoch(1)
+		, m_snapshots(capacity ? capacity : 1)
+		, m_first(0)
+		, m_count(0)
+		, m_nextId(0)
+		, m_retainedBytes(0)
+	{
+	}
+
+	~SnapshotHistory()
+	{
+		for (Snapshot& snapshot : m_snapshots)
+			releaseImages(snapshot);
+		for (char* chunk : m_freeChunks)
+			delete[] chunk;
+	}
+
+	SnapshotHistory(const SnapshotHistory&) = delete;
+	SnapshotHistory& operator=(const SnapshotHistory&) = delete;
+
+	// [1] Read access to the live state
+	const char* data() const { return m_state.data(); }
+	size_t size() const { return m_state.size(); }
+
+	// [2] Writable pointer to [offset, offset + length); saves the before image of
+	// every chunk in the range the first time it is touched since the last capture.
+	// Valid until the next resize().
+	char* write(size_t offset, size_t length)
+	{
+		if (m_count > 0 && length > 0)
+		{
+			const size_t firstChunk = offset / m_chunkSize;
+			const size_t lastChunk = (offset + length - 1) / m_chunkSize;
+			for (size_t chunk = firstChunk; chunk <= lastChunk; ++chunk)
+			{
+				if (m_savedEpoch[chunk] != m_epoch)
+					saveChunk(chunk);
+			}
+		}
+
+		return m_state.data() + offset;
+	}
+
+	void write(size_t offset, const void* source, size_t length)
+	{
+		memcpy(write(offset, length), source, length);
+	}
+
+	template <class T>
+	T* writeAs(size_t offset)
+	{
+		return reinterpret_cast<T*>(write(offset, sizeof(T)));
+	}
+
+	// Growing or shrinking is tracked too: the lost tail is saved before it goes
+	void resize(size_t stateSize)
+	{
+		if (stateSize < m_state.size())
+			write(stateSize, m_state.size() - stateSize);
+
+		m_state.resize(stateSize, 0);
+		trackChunks();
+	}
+
+	// [3] Open a new snapshot of the current state; returns its id
+	uint64_t capture()
+	{
+		if (m_count == m_snapshots.size())
+		{
+			// Ring full: the oldest snapshot goes, its chunk buffers are recycled
+			releaseImages(m_snapshots[m_first]);
+			m_first = (m_first + 1) % m_snapshots.size();
+			--m_count;
+		}
+
+		Snapshot& snapshot = m_snapshots[(m_first + m_count) % m_snapshots.size()];
+		snapshot.id = m_nextId++;
+		snapshot.size = m_state.size();
+		++m_count;
+
+		// Every chunk is clean relative to the new snapshot
+		++m_epoch;
+		return snapshot.id;
+	}
+
+	// [4] Roll the live state back to snapshot id; newer snapshots are dropped
+	bool restore(uint64_t id)
+	{
+		if (m_count == 0 || id < oldest() || id > latest())
+			return false;
+
+		while (m_count > 0)
+		{
+			Snapshot& snapshot = m_snapshots[(m_first + m_count - 1) % m_snapshots.size()];
+
+			// Before images hold the state as it was at this snapshot
+			m_state.resize(snapshot.size, 0);
+			for (const Image& image : snapshot.images)
+				memcpy(m_state.data() + image.chunk * m_chunkSize, image.data, image.length);
+			releaseImages(snapshot);
+
+			if (snapshot.id == id)
+				break;
+			--m_count;
+		}
+
+		trackChunks();
+		m_nextId = id + 1;
+		++m_epoch;
+		return true;
+	}
+
+	uint64_t oldest() const { return m_count ? m_snapshots[m_first].id : INVALID_SNAPSHOT; }
+	uint64_t latest() const { return m_count ? m_snapshots[(m_first + m_count - 1) % m_snapshots.size()].id : INVALID_SNAPSHOT; }
+	unsigned snapshotCount() const { return m_count; }
+
+	// Bytes held in before images, and recycled chunk buffers ready for reuse
+	size_t retainedBytes() const { return m_retainedBytes; }
+	size_t pooledBytes() const { return m_freeChunks.size() * m_chunkSize; }
+
+private:
+	struct Image
+	{
+		size_t chunk;
+		size_t length;
+		char* data;
+	};
+
+	struct Snapshot
+	{
+		uint64_t id = 0;
+		size_t size = 0;
+		// Old contents of chunks changed after this snapshot was taken
+		std::vector<Image> images;
+	};
+
+	// Only ever grows: a chunk cut off and regrown within one epoch must still
+	// count as saved, or its first (correct) before image would be overwritten
+	void trackChunks()
+	{
+		const size_t chunks = (m_state.size() + m_chunkSize - 1) / m_chunkSize;
+		if (chunks > m_savedEpoch.size())
+			m_savedEpoch.resize(chunks, 0);
+	}
+
+	void saveChunk(size_t chunk)
+	{
+		m_savedEpoch[chunk] = m_epoch;
+
+		// A chunk that did not exist at the snapshot has nothing to restore
+		Snapshot& snapshot = m_snapshots[(m_first + m_count - 1) % m_snapshots.size()];
+		const size_t offset = chunk * m_chunkSize;
+		if (offset >= snapshot.size)
+			return;
+
+		Image image;
+		image.chunk = chunk;
+		image.length = snapshot.size - offset < m_chunkSize ? snapshot.size - offset : m_chunkSize;
+		image.data = allocateChunk();
+		memcpy(image.data, m_state.data() + offset, image.length);
+
+		snapshot.images.push_back(image);
+		m_retainedBytes += image.length;
+	}
+
+	char* allocateChunk()
+	{
+		if (m_freeChunks.empty())
+			return new char[m_chunkSize];
+
+		char* chunk = m_freeChunks.back();
+		m_freeChunks.pop_back();
+		return chunk;
+	}
+
+	// Images back to the free list; the vector keeps its capacity
+	void releaseImages(Snapshot& snapshot)
+	{
+		for (const Image& image : snapshot.images)
+		{
+			m_freeChunks.push_back(image.data);
+			m_retainedBytes -= image.length;
+		}
+		snapshot.images.clear();
+	}
+
+private:
+	std::vector<char> m_state;
+	size_t m_chunkSize;
+
+	// Epoch in which each chunk's before image was last saved
+	std::vector<uint32_t> m_savedEpoch;
+	uint32_t m_epoch;
+
+	// Ring of snapshots, oldest at m_first
+	std::vector<Snapshot> m_snapshots;
+	unsigned m_first;
+	unsigned m_count;
+	uint64_t m_nextId;
+
+	std::vector<char*> m_freeChunks;
+	size_t m_retainedBytes;
+};
+
+// How it's used ???
+namespace snapshot_history
+{
+	// A game state that is one flat block of PODs
+	struct Unit
+	{
+		float x, y;
+		int health;
+		int target;
+	};
+
+	void example()
+	{
+		const size_t unitCount = 1000000;	// 16 MB of state
+		SnapshotHistory history(unitCount * sizeof(Unit), 8);
+
+		// Rollback netcode: capture every frame, only touched chunks are copied
+		uint64_t frames[8];
+		for (int frame = 0; frame < 8; ++frame)
+		{
+			frames[frame] = history.capture();
+
+			// Only a handful of units move each frame
+			for (size_t u = frame; u < unitCount; u += 50000)
+				history.writeAs<Unit>(u * sizeof(Unit))->x += 1.0f;
+		}
+
+		std::cout << "8 frames of a " << history.size() / (1024 * 1024) << " MB state retain "
+			<< history.retainedBytes() / 1024 << " KB\n";
+
+		// A late input arrives for frame 3: roll back and resimulate from there
+		history.restore(frames[3]);
+		const Unit* units = reinterpret_cast<const Unit*>(history.data());
+		std::cout << "Unit 3 is back at x = " << units[3].x << "\n";
+	}
+}
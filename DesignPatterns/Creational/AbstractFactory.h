@@ -2,6 +2,7 @@
 
 
 #include <iostream>
+#include "Arena.h"
 
 // !!! Assume we have the following class hiearchy
 class Loot
@@ -52,22 +53,23 @@ public:
 class LootFactory
 {
 public:
-	virtual Loot *makeLoot();
-	virtual Miner* makeMiner();
+	// An arena, when given, owns the returned objects
+	virtual Loot *makeLoot(MonotonicArena* arena = nullptr);
+	virtual Miner* makeMiner(MonotonicArena* arena = nullptr);
 };
 
 class GoldFactory : public LootFactory
 {
 public:
-	Loot *makeLoot() override { return new Gold(); }
-	Miner *makeMiner() override { return new GoldMiner(); }
+	Loot *makeLoot(MonotonicArena* arena = nullptr) override { return arenaNew<Gold>(arena); }
+	Miner *makeMiner(MonotonicArena* arena = nullptr) override { return arenaNew<GoldMiner>(arena); }
 };
 
 class DiamondFactory : public LootFactory
 {
 public:
-	Loot *makeLoot() override { return new Diamond(); }
-	Miner *makeMiner() override { return new DiamondMiner(); }
+	Loot *makeLoot(MonotonicArena* arena = nullptr) override { return arenaNew<Diamond>(arena); }
+	Miner *makeMiner(MonotonicArena* arena = nullptr) override { return arenaNew<DiamondMiner>(arena); }
 };
 
 // How is it used ???
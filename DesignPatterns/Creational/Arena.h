@@ -0,0 +1,188 @@
+#pragma once
+
+/* Monotonic (arena) allocation for objects that share a lifetime
+ *
+ * Most objects made by a factory live exactly as long as a frame or a request.
+ * Instead of one new/delete per object, the arena bump-allocates them out of
+ * large blocks and frees everything at once with reset().
+ *
+ * 		- make<T>() constructs in the arena; destructors of non-trivial types are
+ * 		  recorded and run (in reverse order) by reset()
+ * 		- never delete an object that came from an arena
+ * 		- blocks are kept across reset(), so a steady-state frame does no malloc
+ * 		- ArenaResource adapts an arena to std::pmr::memory_resource, so pmr
+ * 		  containers can allocate from it too
+ *
+ * The factories in this folder take an optional MonotonicArena*; passing
+ * nullptr keeps the plain `new` behaviour.
+ */
+
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+#include <stdint.h>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class MonotonicArena
+{
+public:
+	explicit MonotonicArena(size_t blockSize = 64 * 1024)
+		: m_blockSize(blockSize)
+		, m_block(0)
+		, m_cursor(nullptr)
+		, m_end(nullptr)
+		, m_destructors(nullptr)
+	{
+	}
+
+	~MonotonicArena()
+	{
+		reset();
+		for (Block& block : m_blocks)
+			::operator delete(block.memory);
+	}
+
+	MonotonicArena(const MonotonicArena&) = delete;
+	MonotonicArena& operator=(const MonotonicArena&) = delete;
+
+	void* allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+	{
+		char* aligned = alignUp(m_cursor, alignment);
+		if (!m_cursor || aligned + size > m_end)
+		{
+			nextBlock(size + alignment);
+			aligned = alignUp(m_cursor, alignment);
+		}
+
+		m_cursor = aligned + size;
+		return aligned;
+	}
+
+	template <class T, class... Args>
+	T* make(Args&&... args)
+	{
+		// The destructor record sits in front of the object it destroys
+		DestructorRecord* record = nullptr;
+		if (!std::is_trivially_destructible<T>::value)
+			record = static_cast<DestructorRecord*>(allocate(sizeof(DestructorRecord), alignof(DestructorRecord)));
+
+		T* object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+
+		if (record)
+		{
+			record->destroy = [](void* p) { static_cast<T*>(p)->~T(); };
+			record->object = object;
+			record->previous = m_destructors;
+			m_destructors = record;
+		}
+
+		return object;
+	}
+
+	// Destroy everything made since the last reset and rewind to the first block
+	void reset()
+	{
+		for (DestructorRecord* record = m_destructors; record; record = record->previous)
+			record->destroy(record->object);
+		m_destructors = nullptr;
+
+		m_block = 0;
+		m_cursor = m_blocks.empty() ? nullptr : m_blocks[0].memory;
+		m_end = m_blocks.empty() ? nullptr : m_blocks[0].memory + m_blocks[0].size;
+	}
+
+	size_t bytesReserved() const
+	{
+		size_t bytes = 0;
+		for (const Block& block : m_blocks)
+			bytes += block.size;
+		return bytes;
+	}
+
+private:
+	struct Block
+	{
+		char* memory;
+		size_t size;
+	};
+
+	struct DestructorRecord
+	{
+		void (*destroy)(void*);
+		void* object;
+		DestructorRecord* previous;
+	};
+
+	static char* alignUp(char* p, size_t alignment)
+	{
+		const uintptr_t value = reinterpret_cast<uintptr_t>(p);
+		return reinterpret_cast<char*>((value + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1));
+	}
+
+	void nextBlock(size_t minimumSize)
+	{
+		// Reuse blocks kept from before the last reset when they are big enough
+		const size_t next = m_cursor ? m_block + 1 : 0;
+		for (size_t b = next; b < m_blocks.size(); ++b)
+		{
+			if (m_blocks[b].size >= minimumSize)
+			{
+				std::swap(m_blocks[b], m_blocks[next]);
+				useBlock(next);
+				return;
+			}
+		}
+
+		const size_t size = minimumSize > m_blockSize ? minimumSize : m_blockSize;
+		m_blocks.push_back(Block{ static_cast<char*>(::operator new(size)), size });
+		std::swap(m_blocks.back(), m_blocks[next]);
+		useBlock(next);
+	}
+
+	void useBlock(size_t b)
+	{
+		m_block = b;
+		m_cursor = m_blocks[b].memory;
+		m_end = m_blocks[b].memory + m_blocks[b].size;
+	}
+
+private:
+	size_t m_blockSize;
+	std::vector<Block> m_blocks;
+	size_t m_block;
+	char* m_cursor;
+	char* m_end;
+	DestructorRecord* m_destructors;
+};
+
+// std::pmr view of an arena; deallocate is a no-op until the arena resets
+class ArenaResource : public std::pmr::memory_resource
+{
+public:
+	explicit ArenaResource(MonotonicArena* arena) : m_arena(arena) { }
+
+	MonotonicArena* arena() const { return m_arena; }
+
+protected:
+	void* do_allocate(size_t bytes, size_t alignment) override { return m_arena->allocate(bytes, alignment); }
+	void do_deallocate(void*, size_t, size_t) override { }
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+	{
+		const ArenaResource* resource = dynamic_cast<const ArenaResource*>(&other);
+		return resource && resource->m_arena == m_arena;
+	}
+
+private:
+	MonotonicArena* m_arena;
+};
+
+// Factory helper: construct in the arena when there is one, otherwise with new
+template <class T, class... Args>
+T* arenaNew(MonotonicArena* arena, Args&&... args)
+{
+	if (arena)
+		return arena->make<T>(std::forward<Args>(args)...);
+	return new T(std::forward<Args>(args)...);
+}
@@ -1,5 +1,9 @@
 #pragma once
 
+#include "Arena.h"
+
+class GameConfiguration;
+
 class GameConfigurationBuilder
 {
 
@@ -10,10 +14,7 @@ public:
 	void setOnline(bool online) { this->online = online; }
 	void setDebug(bool debug) { this->debug = debug; }
 
-	GameConfiguration* build()
-	{
-		return new GameConfiguration(this);
-	}
+	GameConfiguration* build(MonotonicArena* arena = nullptr);
 
 public:
 	int playerId = 0;
@@ -51,6 +52,12 @@ private:
 	bool m_debug = false;
 };
 
+// Defined after GameConfiguration so the type is complete
+inline GameConfiguration* GameConfigurationBuilder::build(MonotonicArena* arena)
+{
+	return arenaNew<GameConfiguration>(arena, this);
+}
+
 // how it can be used ???
 namespace builder
 {
@@ -61,5 +68,10 @@ namespace builder
 		builder->setOnline(true);
 
 		GameConfiguration* gameConfig = builder->build();
+
+		// Per-request configurations can come from an arena and be freed together
+		MonotonicArena requestArena;
+		builder->build(&requestArena);
+		requestArena.reset();
 	}
 }
\ No newline at end of file
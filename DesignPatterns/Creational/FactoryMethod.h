@@ -1,6 +1,7 @@
 #pragma once
 
 #include <iostream>
+#include "Arena.h"
 
 
 // !!! say we have the following class set up
@@ -33,14 +34,15 @@ class EmployeeLead
 {
 
 public:
-	void performMeeting()
+	// Employees made for one meeting can all live in the caller's arena
+	void performMeeting(MonotonicArena* arena = nullptr)
 	{
-		Employee* employee = makeEmployee();
+		Employee* employee = makeEmployee(arena);
 		employee->giveReport();
 	}
 
 protected:
-	virtual Employee *makeEmployee();
+	virtual Employee *makeEmployee(MonotonicArena* arena = nullptr);
 };
 
 // !!! We can make derived `Lead` classes that would make the `makeEmployee` specific
@@ -48,18 +50,18 @@ protected:
 class ProgrammerLead : public EmployeeLead
 {
 protected:
-	Employee *makeEmployee() override
+	Employee *makeEmployee(MonotonicArena* arena = nullptr) override
 	{
-		return new Programmer();
+		return arenaNew<Programmer>(arena);
 	}
 };
 
 class ArtistLead : public EmployeeLead
 {
 protected:
-	Employee *makeEmployee() override
+	Employee *makeEmployee(MonotonicArena* arena = nullptr) override
 	{
-		return new Artist();
+		return arenaNew<Artist>(arena);
 	}
 };
 
@@ -7,11 +7,36 @@
  * Object pool let others check-out objects from the pool
  * Object pool instantiates new objects when required
  * Object pool manages life time of objects in the pool and do clean up of unused objects periodically
+ *
+ * This pool is built for many threads acquiring and releasing at a high rate:
+ * 		- objects live in contiguous slab chunks, constructed once and reused
+ * 		- every thread keeps a small cache of free objects, so the hot path is a
+ * 		  thread local pointer pop/push with no lock, atomic or malloc
+ * 		- caches trade whole batches with a global lock-free (Treiber) stack;
+ * 		  the stack head carries a tag counter so a pop can't suffer from ABA
+ * 		- only growing the pool by a new chunk takes a mutex and allocates
+ *
+ * acquire() hands out a move-only PoolPtr that goes back to the pool when it is
+ * destroyed. acquireN/releaseN move objects a whole batch at a time, so bulk
+ * users touch the shared stack once per batch rather than once per object.
+ *
+ * stats() reports how the pool is used, to size it from real data. Counters are
+ * per thread and bumped with relaxed stores, so they cost next to nothing on the
+ * hot path; the high-water mark is tracked whenever batches move, which makes it
+ * exact up to the objects sitting in thread caches.
  */
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <iostream>
+#include <mutex>
+#include <new>
+#include <stdint.h>
 #include <string>
-#include <list>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 
 // !!! Suppose this is the object we want to pool
@@ -27,49 +52,545 @@ private:
 	int m_value;
 };
 
-// !!! have a singleton object pool class
+// Objects with a reset() method get it called when they go back to the pool
+template <class T, class = void>
+struct PoolReset
+{
+	static void reset(T &) { }
+};
+
+template <class T>
+struct PoolReset<T, decltype(std::declval<T &>().reset(), void())>
+{
+	static void reset(T &object) { object.reset(); }
+};
+
+// Snapshot of pool counters
+struct PoolStats
+{
+	uint64_t acquires = 0;
+	uint64_t releases = 0;
+
+	// Refills of a thread cache from the shared stack, and the subset that
+	// found it empty and had to construct a new chunk
+	uint64_t cacheRefills = 0;
+	uint64_t chunkAllocations = 0;
+
+	// Failed CAS attempts on the shared stack and waits on the chunk mutex
+	uint64_t casRetries = 0;
+	uint64_t lockWaits = 0;
+
+	uint64_t capacity = 0;
+	uint64_t highWaterMark = 0;
+
+	uint64_t live() const { return acquires - releases; }
+	double missRate() const { return acquires ? static_cast<double>(cacheRefills) / acquires : 0.0; }
+	double allocationRate() const { return acquires ? static_cast<double>(chunkAllocations) / acquires : 0.0; }
+
+	void print(std::ostream& out) const
+	{
+		out << "pool: live " << live() << " / capacity " << capacity << " (high-water " << highWaterMark << "), "
+			<< acquires << " acquires, miss rate " << missRate() << ", "
+			<< chunkAllocations << " chunk allocations, "
+			<< casRetries << " CAS retries, " << lockWaits << " lock waits\n";
+	}
+};
+
+template <class T, unsigned int BatchSize = 64, unsigned int BatchesPerChunk = 16>
+class ObjectPool;
+
+// Owning handle to a pooled object, released back to its pool on destruction
+template <class T, unsigned int BatchSize = 64, unsigned int BatchesPerChunk = 16>
+class PoolPtr
+{
+public:
+	typedef ObjectPool<T, BatchSize, BatchesPerChunk> Pool;
+
+	PoolPtr() : m_object(nullptr) { }
+	explicit PoolPtr(T* object) : m_object(object) { }
+	PoolPtr(PoolPtr&& other) : m_object(other.release()) { }
+	~PoolPtr() { reset(); }
+
+	PoolPtr(const PoolPtr&) = delete;
+	PoolPtr& operator=(const PoolPtr&) = delete;
+
+	PoolPtr& operator=(PoolPtr&& other)
+	{
+		if (this != &other)
+		{
+			reset();
+			m_object = other.release();
+		}
+		return *this;
+	}
+
+	T* get() const { return m_object; }
+	T* operator->() const { return m_object; }
+	T& operator*() const { return *m_object; }
+	explicit operator bool() const { return m_object != nullptr; }
+
+	// Give up ownership without returning the object to the pool
+	T* release()
+	{
+		T* object = m_object;
+		m_object = nullptr;
+		return object;
+	}
+
+	void reset()
+	{
+		if (m_object)
+			Pool::getInstance().releaseResource(release());
+	}
+
+private:
+	T* m_object;
+};
+
+// !!! have a singleton object pool class, one per pooled type
+template <class T, unsigned int BatchSize, unsigned int BatchesPerChunk>
 class ObjectPool
 {
 public:
 	// Static method for accessing the object pool instance
-	static ObjectPool* getInstance()
+	// (function local static, so first use is thread safe)
+	static ObjectPool& getInstance()
 	{
-		if (!m_instance)
+		static ObjectPool instance;
+		return instance;
+	}
+
+	~ObjectPool()
+	{
+		for (Node* chunk : m_chunks)
 		{
-			m_instance = new ObjectPool;
+			for (unsigned int i = 0; i < CHUNK_SIZE; ++i)
+				chunk[i].object()->~T();
+			::operator delete(static_cast<void*>(chunk));
 		}
-
-		return m_instance;
 	}
 
+	ObjectPool(const ObjectPool&) = delete;
+	ObjectPool& operator=(const ObjectPool&) = delete;
 
 	// !!! Acquire
-	Resource* acquireResource()
+	T* acquireResource()
 	{
-		if (m_resources.empty())
+		ThreadCache& cache = threadCache();
+		bump(cache.stats.acquires);
+		if (!cache.current)
+			refill(cache);
+
+		Node* node = cache.current;
+		cache.current = node->next;
+		cache.count--;
+		return node->object();
+	}
+
+	// !!! Release
+	void releaseResource(T* resource)
+	{
+		PoolReset<T>::reset(*resource);
+
+		ThreadCache& cache = threadCache();
+		bump(cache.stats.releases);
+		Node* node = Node::fromObject(resource);
+		node->next = cache.current;
+		cache.current = node;
+
+		// A full batch is parked as the spare; the previous spare goes global
+		if (++cache.count == BatchSize)
 		{
-			return new Resource();
+			if (cache.spare)
+				pushBatch(cache.spare);
+			cache.spare = cache.current;
+			cache.spare->batchCount = BatchSize;
+			cache.current = nullptr;
+			cache.count = 0;
 		}
-		
-		else
+	}
+
+	// !!! Acquire with automatic release
+	PoolPtr<T, BatchSize, BatchesPerChunk> acquire()
+	{
+		return PoolPtr<T, BatchSize, BatchesPerChunk>(acquireResource());
+	}
+
+	// Fill objects[0, count), refilling the thread cache a whole batch at a time
+	void acquireN(T** objects, size_t count)
+	{
+		ThreadCache& cache = threadCache();
+		bump(cache.stats.acquires, count);
+		size_t filled = 0;
+		while (filled < count)
 		{
-			Resource* resource = const_cast<Resource*>(m_resources.front());
-			m_resources.pop_front();
-			return resource;
+			if (!cache.current)
+				refill(cache);
+
+			Node* node = cache.current;
+			while (node && filled < count)
+			{
+				objects[filled++] = node->object();
+				node = node->next;
+				cache.count--;
+			}
+			cache.current = node;
 		}
 	}
 
-	// !!! Release
-	void releaseResource(Resource* resource)
+	// Return objects[0, count); full batches go straight to the shared stack
+	// with one CAS each, the remainder through the thread cache
+	void releaseN(T** objects, size_t count)
+	{
+		size_t i = 0;
+		bump(threadCache().stats.releases, count - count % BatchSize);
+		for (; i + BatchSize <= count; i += BatchSize)
+		{
+			Node* batch = nullptr;
+			for (size_t j = i; j < i + BatchSize; ++j)
+			{
+				PoolReset<T>::reset(*objects[j]);
+				Node* node = Node::fromObject(objects[j]);
+				node->next = batch;
+				batch = node;
+			}
+			batch->batchCount = BatchSize;
+			pushBatch(batch);
+		}
+
+		for (; i < count; ++i)
+			releaseResource(objects[i]);
+	}
+
+	// Number of objects constructed so far
+	size_t capacity() const { return m_capacity.load(std::memory_order_relaxed); }
+
+	PoolStats stats()
+	{
+		PoolStats result;
+		std::lock_guard<std::mutex> lock(m_statsMutex);
+		m_retired.addTo(result);
+		for (ThreadStats* threadStats : m_threadStats)
+			threadStats->addTo(result);
+
+		result.capacity = capacity();
+		result.highWaterMark = m_highWaterMark.load(std::memory_order_relaxed);
+		return result;
+	}
+
+	void dumpStats(std::ostream& out) { stats().print(out); }
+
+private:
+	static const unsigned int CHUNK_SIZE = BatchSize * BatchesPerChunk;
+
+	// The object comes first so a T* converts back to its node
+	struct Node
+	{
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+		Node* next;
+		std::atomic<Node*> nextBatch;
+		unsigned int batchCount;
+
+		T* object() { return reinterpret_cast<T*>(&storage); }
+		static Node* fromObject(T* object) { return reinterpret_cast<Node*>(object); }
+	};
+
+	// Counters written only by the owning thread, read by stats()
+	struct ThreadStats
+	{
+		std::atomic<uint64_t> acquires{0};
+		std::atomic<uint64_t> releases{0};
+		std::atomic<uint64_t> cacheRefills{0};
+		std::atomic<uint64_t> chunkAllocations{0};
+		std::atomic<uint64_t> casRetries{0};
+		std::atomic<uint64_t> lockWaits{0};
+
+		void addTo(PoolStats& result) const
+		{
+			result.acquires += acquires.load(std::memory_order_relaxed);
+			result.releases += releases.load(std::memory_order_relaxed);
+			result.cacheRefills += cacheRefills.load(std::memory_order_relaxed);
+			result.chunkAllocations += chunkAllocations.load(std::memory_order_relaxed);
+			result.casRetries += casRetries.load(std::memory_order_relaxed);
+			result.lockWaits += lockWaits.load(std::memory_order_relaxed);
+		}
+
+		void addTo(ThreadStats& result) const
+		{
+			bump(result.acquires, acquires.load(std::memory_order_relaxed));
+			bump(result.releases, releases.load(std::memory_order_relaxed));
+			bump(result.cacheRefills, cacheRefills.load(std::memory_order_relaxed));
+			bump(result.chunkAllocations, chunkAllocations.load(std::memory_order_relaxed));
+			bump(result.casRetries, casRetries.load(std::memory_order_relaxed));
+			bump(result.lockWaits, lockWaits.load(std::memory_order_relaxed));
+		}
+	};
+
+	// Free objects owned by one thread: a partial list plus one full spare batch
+	struct ThreadCache
+	{
+		Node* current = nullptr;
+		unsigned int count = 0;
+		Node* spare = nullptr;
+		ThreadStats stats;
+
+		ThreadCache()
+		{
+			ObjectPool& pool = ObjectPool::getInstance();
+			std::lock_guard<std::mutex> lock(pool.m_statsMutex);
+			pool.m_threadStats.push_back(&stats);
+		}
+
+		~ThreadCache()
+		{
+			// Hand everything back when the thread exits
+			ObjectPool& pool = ObjectPool::getInstance();
+			if (current)
+			{
+				current->batchCount = count;
+				pool.pushBatch(current);
+			}
+			if (spare)
+				pool.pushBatch(spare);
+
+			// Keep this thread's counters in the totals
+			std::lock_guard<std::mutex> lock(pool.m_statsMutex);
+			stats.addTo(pool.m_retired);
+			for (size_t i = 0; i < pool.m_threadStats.size(); ++i)
+			{
+				if (pool.m_threadStats[i] == &stats)
+				{
+					pool.m_threadStats[i] = pool.m_threadStats.back();
+					pool.m_threadStats.pop_back();
+					break;
+				}
+			}
+		}
+	};
+
+	// Single writer increment; the store is atomic only so readers never tear
+	static void bump(std::atomic<uint64_t>& counter, uint64_t amount = 1)
+	{
+		counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+	}
+
+	// Tagged stack head: pointer in the low bits, modification counter above
+	static const unsigned int TAG_SHIFT = sizeof(void*) == 8 ? 48 : 32;
+	static const uint64_t POINTER_MASK = (uint64_t(1) << TAG_SHIFT) - 1;
+
+	static Node* headPointer(uint64_t head) { return reinterpret_cast<Node*>(static_cast<uintptr_t>(head & POINTER_MASK)); }
+	static uint64_t makeHead(Node* node, uint64_t previous)
 	{
-		resource->reset();
-		m_resources.push_back(resource);
+		const uint64_t tag = (previous >> TAG_SHIFT) + 1;
+		return (tag << TAG_SHIFT) | static_cast<uint64_t>(reinterpret_cast<uintptr_t>(node));
 	}
 
 private:
-	ObjectPool();
+	ObjectPool() : m_globalHead(0), m_capacity(0), m_globalFree(0), m_highWaterMark(0) { }
+
+	static ThreadCache& threadCache()
+	{
+		static thread_local ThreadCache cache;
+		return cache;
+	}
+
+	void pushBatch(Node* batch)
+	{
+		// Once the CAS publishes the batch another thread may pop and reuse it,
+		// so its count must be read before
+		const unsigned count = batch->batchCount;
+
+		uint64_t head = m_globalHead.load(std::memory_order_relaxed);
+		uint64_t retries = 0;
+		for (;;)
+		{
+			batch->nextBatch.store(headPointer(head), std::memory_order_relaxed);
+			if (m_globalHead.compare_exchange_weak(head, makeHead(batch, head), std::memory_order_release, std::memory_order_relaxed))
+				break;
+			++retries;
+		}
+
+		m_globalFree.fetch_add(count, std::memory_order_relaxed);
+		if (retries)
+			bump(threadCache().stats.casRetries, retries);
+	}
+
+	// Objects outside the shared stack are live or cached by some thread
+	void updateHighWaterMark()
+	{
+		const int64_t outside = static_cast<int64_t>(capacity()) - m_globalFree.load(std::memory_order_relaxed);
+		uint64_t mark = m_highWaterMark.load(std::memory_order_relaxed);
+		while (outside > static_cast<int64_t>(mark) && !m_highWaterMark.compare_exchange_weak(mark, outside, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	Node* popBatch()
+	{
+		uint64_t head = m_globalHead.load(std::memory_order_acquire);
+		uint64_t retries = 0;
+		Node* batch = nullptr;
+		for (;;)
+		{
+			batch = headPointer(head);
+			if (!batch)
+				break;
+
+			// Nodes are never freed while the pool lives, so reading a batch
+			// another thread just popped is harmless; the tag rejects the CAS
+			Node* next = batch->nextBatch.load(std::memory_order_relaxed);
+			if (m_globalHead.compare_exchange_weak(head, makeHead(next, head), std::memory_order_acquire, std::memory_order_acquire))
+				break;
+			++retries;
+		}
+
+		if (retries)
+			bump(threadCache().stats.casRetries, retries);
+		if (batch)
+		{
+			m_globalFree.fetch_sub(batch->batchCount, std::memory_order_relaxed);
+			updateHighWaterMark();
+		}
+		return batch;
+	}
+
+	void refill(ThreadCache& cache)
+	{
+		if (cache.spare)
+		{
+			cache.current = cache.spare;
+			cache.count = cache.spare->batchCount;
+			cache.spare = nullptr;
+			return;
+		}
+
+		bump(cache.stats.cacheRefills);
+		Node* batch = popBatch();
+		if (!batch)
+		{
+			bump(cache.stats.chunkAllocations);
+			batch = allocateChunk();
+		}
+
+		cache.current = batch;
+		cache.count = batch->batchCount;
+	}
+
+	// Slow path: construct a new chunk, keep one batch and publish the rest
+	Node* allocateChunk()
+	{
+		Node* chunk = static_cast<Node*>(::operator new(sizeof(Node) * CHUNK_SIZE));
+		for (unsigned int i = 0; i < CHUNK_SIZE; ++i)
+		{
+			new (chunk[i].object()) T();
+			chunk[i].next = (i + 1) % BatchSize ? &chunk[i + 1] : nullptr;
+			new (&chunk[i].nextBatch) std::atomic<Node*>(nullptr);
+			chunk[i].batchCount = BatchSize;
+		}
+
+		{
+			std::unique_lock<std::mutex> lock(m_chunkMutex, std::try_to_lock);
+			if (!lock.owns_lock())
+			{
+				bump(threadCache().stats.lockWaits);
+				lock.lock();
+			}
+			m_chunks.push_back(chunk);
+		}
+		// Publish the spare batches before growing capacity, so a concurrent
+		// high-water update never counts them as in use
+		for (unsigned int b = 1; b < BatchesPerChunk; ++b)
+			pushBatch(&chunk[b * BatchSize]);
+		m_capacity.fetch_add(CHUNK_SIZE, std::memory_order_relaxed);
+		updateHighWaterMark();
+
+		return chunk;
+	}
 
 private:
-	static ObjectPool* m_instance;
-	std::list<Resource*> m_resources;
-};
\ No newline at end of file
+	std::atomic<uint64_t> m_globalHead;
+	std::atomic<size_t> m_capacity;
+
+	std::mutex m_chunkMutex;
+	std::vector<Node*> m_chunks;
+
+	// Free objects in the shared stack and the most ever outside of it
+	std::atomic<int64_t> m_globalFree;
+	std::atomic<uint64_t> m_highWaterMark;
+
+	// Live threads' counters plus the totals of threads that exited
+	std::mutex m_statsMutex;
+	std::vector<ThreadStats*> m_threadStats;
+	ThreadStats m_retired;
+};
+
+// Prints a pool's stats at a fixed interval until destroyed
+template <class Pool>
+class PoolStatsReporter
+{
+public:
+	PoolStatsReporter(std::chrono::milliseconds interval, std::ostream& out = std::cout)
+		: m_stop(false)
+	{
+		m_thread = std::thread([this, interval, &out]()
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while (!m_wake.wait_for(lock, interval, [this]() { return m_stop; }))
+				Pool::getInstance().dumpStats(out);
+		});
+	}
+
+	~PoolStatsReporter()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_wake.notify_one();
+		m_thread.join();
+	}
+
+private:
+	bool m_stop;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::thread m_thread;
+};
+
+// How it's used ???
+namespace object_pool
+{
+	void example()
+	{
+		ObjectPool<Resource>& pool = ObjectPool<Resource>::getInstance();
+
+		Resource* one = pool.acquireResource();
+		Resource* two = pool.acquireResource();
+		one->setValue(10);
+		two->setValue(20);
+		std::cout << "Resources hold " << one->getValue() << " and " << two->getValue() << "\n";
+
+		// Released objects are reset and handed out again without a new allocation
+		pool.releaseResource(one);
+		Resource* three = pool.acquireResource();
+		std::cout << "Reused resource holds " << three->getValue() << "\n";
+
+		pool.releaseResource(two);
+		pool.releaseResource(three);
+
+		// Handles release themselves when they go out of scope
+		{
+			PoolPtr<Resource> handle = pool.acquire();
+			handle->setValue(42);
+			std::cout << "Handle holds " << handle->getValue() << "\n";
+		}
+
+		// Bulk spawn and despawn, e.g. a particle emitter
+		std::vector<Resource*> particles(1000);
+		pool.acquireN(particles.data(), particles.size());
+		pool.releaseN(particles.data(), particles.size());
+
+		// Size the pool from what it actually saw
+		pool.dumpStats(std::cout);
+	}
+}
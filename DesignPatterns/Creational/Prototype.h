@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <string>
+#include "Arena.h"
 
 // Prototype is used when we need to create an object that is very similar to an existing one
 // but creating one from scratch is more expensive
@@ -26,10 +27,10 @@ public:
 	void setExperience(const int experience) { m_experience = experience; }
 	void setCurrency(const int currency) { m_currency = currency; }
 
-	// !!! Clone the object
-	Player* clone()
+	// !!! Clone the object (into an arena when one is given)
+	Player* clone(MonotonicArena* arena = nullptr)
 	{
-		return new Player(*this);
+		return arenaNew<Player>(arena, *this);
 	}
 
 private:
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "Arena.h"
+
 
 // NOTE: SUPPOSE WE HAVE THE FOLLOWING SCENARIO:
 
@@ -53,13 +55,14 @@ public:
 class ShapeFactory
 {
 public:
-	static Shape* makeRectangle(float width, float height)
+	// Pass an arena to bump-allocate shapes that share a frame or request lifetime
+	static Shape* makeRectangle(float width, float height, MonotonicArena* arena = nullptr)
 	{
-		return new Rectangle(width, height);
+		return arenaNew<Rectangle>(arena, width, height);
 	}
 
-	static Shape* makeTriangle(float width, float height)
+	static Shape* makeTriangle(float width, float height, MonotonicArena* arena = nullptr)
 	{
-		return new Triangle(width, height);
+		return arenaNew<Triangle>(arena, width, height);
 	}
-}
\ No newline at end of file
+};
@@ -1,3 +1,5 @@
+#pragma once
+
 /* Use singleotn when we one and only one instance of an object
  *
  * Checklist:
@@ -5,42 +7,112 @@
  * 		- public static method to get the instance
  * 		- private or protected constructors
  * 		- lazy initialization (creation on first use)
+ *
+ * 		- !!! initialization must be thread safe: a function-local static is
+ * 		  constructed exactly once (C++11 "magic statics"), and after that the
+ * 		  access is a single already-initialized check, no lock
+ * 		- !!! state that many threads update (counters) should be sharded so
+ * 		  the threads do not fight over one cache line
  */
 
+#include <atomic>
 #include <iostream>
+#include <stdint.h>
+
+// Reusable singleton base: class Foo : public Singleton<Foo> { friend class Singleton<Foo>; ... };
+template <class T>
+class Singleton
+{
+public:
+	static T& instance()
+	{
+		// !!! Thread-safe lazy initialization, guaranteed by the language
+		static T s_instance;
+		return s_instance;
+	}
+
+	Singleton(const Singleton&) = delete;
+	Singleton& operator=(const Singleton&) = delete;
+
+protected:
+	Singleton() = default;
+	~Singleton() = default;
+};
+
+
+// Counter split into cache-line sized shards; each thread bumps its own shard
+// and readers sum them. Increments are relaxed atomics on a line nobody else
+// writes to (as long as there are no more threads than shards).
+class ShardedCounter
+{
+public:
+	static const unsigned SHARD_COUNT = 64;
+
+	ShardedCounter() { reset(); }
+
+	void add(int64_t value)
+	{
+		m_shards[shardIndex()].value.fetch_add(value, std::memory_order_relaxed);
+	}
+
+	// Not a snapshot: increments racing with total() may or may not be counted
+	int64_t total() const
+	{
+		int64_t sum = 0;
+		for (const Shard& shard : m_shards)
+			sum += shard.value.load(std::memory_order_relaxed);
+		return sum;
+	}
+
+	void reset()
+	{
+		for (Shard& shard : m_shards)
+			shard.value.store(0, std::memory_order_relaxed);
+	}
+
+private:
+	struct alignas(64) Shard
+	{
+		std::atomic<int64_t> value;
+	};
+
+	static unsigned shardIndex()
+	{
+		// Threads get shards round robin the first time they touch any counter
+		static std::atomic<unsigned> s_nextShard(0);
+		thread_local unsigned t_shard = s_nextShard.fetch_add(1, std::memory_order_relaxed) % SHARD_COUNT;
+		return t_shard;
+	}
+
+private:
+	Shard m_shards[SHARD_COUNT];
+};
+
 
 // i.e. we want to have an achievement tracker, but the entire game should only have one
-class AchievementTracker
+class AchievementTracker : public Singleton<AchievementTracker>
 {
+	// Singleton<T> needs the private constructor
+	friend class Singleton<AchievementTracker>;
+
 public:
 	// public static method getter
 	static AchievementTracker* getInstance()
 	{
-		// Lazy initialization
-		if (!m_instance)
-		{
-			m_instance = new AchievementTracker();
-		}
-
-		return m_instance;
+		return &instance();
 	}
 
-	// Other stuff
-	void reset() { m_counter = 0; }
-	void increment(int value) { m_counter += value; }
-	bool getAchievementUnlocked() { return m_counter >= 5; }
+	// Other stuff (safe to call from any thread)
+	void reset() { m_counter.reset(); }
+	void increment(int value) { m_counter.add(value); }
+	bool getAchievementUnlocked() const { return m_counter.total() >= 5; }
 
 private:
 	// Private constructor
-	AchievementTracker()
-	{
-		m_counter = 0;
-	}
+	AchievementTracker() = default;
 
 private:
-	// Private static member to hold the single instance
-	static AchievementTracker* m_instance;
-	int m_counter;
+	ShardedCounter m_counter;
 };
 
 
@@ -84,4 +156,4 @@ namespace singleton
 		std::cout << AchievementTracker::getInstance()->getAchievementUnlocked() << std::endl;
 		// expecting true
 	}
-}
\ No newline at end of file
+}
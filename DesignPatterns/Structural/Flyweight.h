@@ -27,22 +27,13 @@
 #pragma once
 
 #include <iostream>
+#include <memory>
 #include <string>
-#include <unordered_map>
+#include "FlyweightCache.h"
 
-// [OPTIONAL: instead of using string to access cache, we can hash it]
-int getStringHash(const std::string& str)
-{
-	// Starting with prime number
-	int hash = 13;
-
-	for (int i = 0; i < str.length(); i++)
-	{
-		hash = hash * 101 + str[i];
-	}
-
-	return hash;
-}
+// !!! Never key the cache by a bare hash of the path: two paths that collide
+// would silently share one texture. FlyweightCache hashes to find a bucket and
+// then compares the whole key.
 
 // Suppose we have this texture class that's being used everywhere
 // It holds a reference to a texture path and displays a texture
@@ -56,6 +47,9 @@ public:
 		m_height = height;
 	}
 
+	// Used as the cache cost, so the budget is in bytes
+	size_t memoryUsage() const { return static_cast<size_t>(m_width) * m_height * 4; }
+
 	// Extrinsic states are passed via parameters
 	void display(int x, int y)
 	{
@@ -77,36 +71,55 @@ class TextureFlyweightFactory
 {
 public:
 
-	// Factory get instance
-	static Texture* getTexture(const std::string& path, int width, int height)
+	struct TextureCost
 	{
-		// First we check if we already have existing texture class to share
-		const int textureKey = getStringHash(path);
-		if (m_cachedTexturesMap.find(textureKey) == m_cachedTexturesMap.end())
-		{
-			// Does not exist
-			Texture *newTexture = new Texture(path);
-			newTexture->setSize(width, height);
-			m_cachedTexturesMap[textureKey] = newTexture;
+		size_t operator()(const Texture& texture) const { return texture.memoryUsage(); }
+	};
+
+	typedef FlyweightCache<std::string, Texture, TextureCost> Cache;
 
-			std::cout << "Creating new texture\n";
+	// Textures beyond this many bytes are evicted, roughly least recently used first
+	static const size_t TEXTURE_BUDGET = 256 * 1024 * 1024;
 
+	// Factory get instance; safe to call from every draw call on every thread.
+	// The shared_ptr keeps the texture alive even if the cache evicts it.
+	static std::shared_ptr<Texture> getTexture(const std::string& path, int width, int height)
+	{
+		// First we check if we already have existing texture class to share,
+		// otherwise create it (outside of any lock)
+		return cache().getOrCreate(path, [&]() {
+			Texture* newTexture = new Texture(path);
+			newTexture->setSize(width, height);
 			return newTexture;
-		}
-		else
-		{
-			// Exist, return object
-			std::cout << "Reusing texture\n";
-
-			return m_cachedTexturesMap[textureKey];
-		}
+		});
 	}
 
-private:
+	// Non-blocking variant for level loads: misses are read on the I/O pool, and
+	// every caller asking for the same path while it loads shares that one load
+	static std::shared_future<std::shared_ptr<Texture>> getAsync(const std::string& path, int width, int height)
+	{
+		// The cache is constructed first so it outlives the pool's pending loads
+		Cache& textures = cache();
+		FlyweightLoadPool& pool = loadPool();
+		return textures.getAsync(path, [path, width, height]() {
+			Texture* newTexture = new Texture(path);
+			newTexture->setSize(width, height);
+			return newTexture;
+		}, pool);
+	}
 
-	// We can also use a vector if the key is stored inside the object itself
-	static std::unordered_map<int, Texture*> m_cachedTexturesMap;
+	static Cache& cache()
+	{
+		// Constructed once, thread safe
+		static Cache s_cache(TEXTURE_BUDGET);
+		return s_cache;
+	}
 
+	static FlyweightLoadPool& loadPool()
+	{
+		static FlyweightLoadPool s_pool(2);
+		return s_pool;
+	}
 };
 
 // How it's used ???
@@ -118,16 +131,23 @@ namespace flyweight
 		std::string path2 = "background.png";
 
 		// Create some stuff
-		Texture* texture1 = TextureFlyweightFactory::getTexture(path1, 100, 200);
-		Texture* texture2 = TextureFlyweightFactory::getTexture(path2, 800, 600);
+		std::shared_ptr<Texture> texture1 = TextureFlyweightFactory::getTexture(path1, 100, 200);
+		std::shared_ptr<Texture> texture2 = TextureFlyweightFactory::getTexture(path2, 800, 600);
 
 		// Expecting reusing texture
-		Texture *texture3 = TextureFlyweightFactory::getTexture(path1, 50, 50);
-		Texture *texture4 = TextureFlyweightFactory::getTexture(path1, 20, 20);
+		std::shared_ptr<Texture> texture3 = TextureFlyweightFactory::getTexture(path1, 50, 50);
+		std::shared_ptr<Texture> texture4 = TextureFlyweightFactory::getTexture(path1, 20, 20);
 
 		texture1->display(50, 50);
 		texture2->display(0, 0);
 		texture3->display(100, 0);
 		texture4->display(0, 100);
+
+		// Kick off loads for the next level without blocking; both requests for
+		// "rock.png" share one load
+		auto rock = TextureFlyweightFactory::getAsync("rock.png", 64, 64);
+		auto rockAgain = TextureFlyweightFactory::getAsync("rock.png", 64, 64);
+		rock.get()->display(10, 10);
+		rockAgain.get()->display(20, 20);
 	}
-}
\ No newline at end of file
+}
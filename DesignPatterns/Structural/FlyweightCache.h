@@ -0,0 +1,443 @@
+#pragma once
+
+/* Generic, thread-safe flyweight cache
+ *
+ * 		- keys are compared in full, the hash only picks a shard and a bucket,
+ * 		  so two keys that collide never share a value
+ * 		- the table is split into lock-striped shards; a hit takes a shared lock
+ * 		  on one shard only, so lookups from many threads do not serialize
+ * 		- values are handed out as shared_ptr, an evicted value stays alive for
+ * 		  whoever still holds it
+ * 		- each shard keeps its part of the budget with CLOCK (second chance)
+ * 		  eviction: a hit sets a reference bit, the hand clears it once and
+ * 		  evicts on the second pass
+ *
+ * 		- a miss is loaded once: concurrent requests for the same key wait on
+ * 		  the one in-flight load instead of building their own copy, and
+ * 		  getAsync() runs that load on a FlyweightLoadPool
+ *
+ * Cost is measured by the Cost functor (one unit per entry by default), so the
+ * budget can be an entry count or a byte count.
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdint.h>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct FlyweightUnitCost
+{
+	template <class Value>
+	size_t operator()(const Value&) const { return 1; }
+};
+
+// std::hash is the identity for integers on some standard libraries; a
+// finalizer spreads every input bit so the top bits can pick the shard
+template <class Key, class Hash = std::hash<Key>>
+struct FlyweightHash
+{
+	size_t operator()(const Key& key) const
+	{
+		uint64_t h = static_cast<uint64_t>(Hash()(key));
+		h ^= h >> 30;
+		h *= 0xBF58476D1CE4E5B9ULL;
+		h ^= h >> 27;
+		h *= 0x94D049BB133111EBULL;
+		h ^= h >> 31;
+		return static_cast<size_t>(h);
+	}
+};
+
+// Small background pool for flyweight loads (disk, decode, upload...).
+// Queued loads still run on destruction so no waiter is left hanging.
+class FlyweightLoadPool
+{
+public:
+	explicit FlyweightLoadPool(unsigned threadCount = 2)
+		: m_stop(false)
+	{
+		for (unsigned t = 0; t < (threadCount ? threadCount : 1); ++t)
+			m_threads.emplace_back([this]() { run(); });
+	}
+
+	~FlyweightLoadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_wake.notify_all();
+		for (std::thread& thread : m_threads)
+			thread.join();
+	}
+
+	FlyweightLoadPool(const FlyweightLoadPool&) = delete;
+	FlyweightLoadPool& operator=(const FlyweightLoadPool&) = delete;
+
+	void submit(std::function<void()> task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_tasks.push_back(std::move(task));
+		}
+		m_wake.notify_one();
+	}
+
+private:
+	void run()
+	{
+		for (;;)
+		{
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wake.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+				if (m_tasks.empty())
+					return;
+
+				task = std::move(m_tasks.front());
+				m_tasks.pop_front();
+			}
+			task();
+		}
+	}
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::deque<std::function<void()>> m_tasks;
+	std::vector<std::thread> m_threads;
+	bool m_stop;
+};
+
+template <class Key, class Value, class Cost = FlyweightUnitCost, class Hash = FlyweightHash<Key>>
+class FlyweightCache
+{
+public:
+	typedef std::shared_ptr<Value> Pointer;
+	typedef std::shared_future<Pointer> Future;
+
+	explicit FlyweightCache(size_t budget = SIZE_MAX, unsigned shardCount = 16)
+		: m_shardCount(shardCount ? shardCount : 1)
+		, m_shards(new Shard[m_shardCount])
+	{
+		const size_t shardBudget = budget / m_shardCount + (budget % m_shardCount ? 1 : 0);
+		for (unsigned s = 0; s < m_shardCount; ++s)
+			m_shards[s].budget = shardBudget;
+	}
+
+	FlyweightCache(const FlyweightCache&) = delete;
+	FlyweightCache& operator=(const FlyweightCache&) = delete;
+
+	// Cached value or null; a hit only takes the shard's shared lock
+	std::shared_ptr<Value> find(const Key& key) const
+	{
+		const size_t hash = Hash()(key);
+		Shard& shard = shardFor(hash);
+
+		std::shared_lock<std::shared_mutex> lock(shard.mutex);
+		auto it = shard.index.find(key);
+		if (it == shard.index.end())
+			return nullptr;
+
+		it->second.referenced.store(true, std::memory_order_relaxed);
+		return it->second.value;
+	}
+
+	// Cached value, or create() it on this thread and insert. create runs without
+	// any lock held; other threads missing on the same key meanwhile wait for it.
+	template <class Create>
+	std::shared_ptr<Value> getOrCreate(const Key& key, Create&& create)
+	{
+		if (std::shared_ptr<Value> value = find(key))
+			return value;
+
+		Shard& shard = shardFor(Hash()(key));
+		Future future;
+		std::shared_ptr<std::promise<Pointer>> load;
+		if (!claim(shard, key, future, load))
+			return future.get();
+
+		Pointer value;
+		try
+		{
+			value = Pointer(create());
+		}
+		catch (...)
+		{
+			fail(shard, key, *load, std::current_exception());
+			throw;
+		}
+		return publish(shard, key, *load, std::move(value));
+	}
+
+	// Like getOrCreate, but a miss is loaded on the pool and the caller gets a
+	// future right away. The cache must outlive the loads it queued.
+	template <class Create>
+	Future getAsync(const Key& key, Create create, FlyweightLoadPool& pool)
+	{
+		if (std::shared_ptr<Value> value = find(key))
+			return ready(std::move(value));
+
+		Shard& shard = shardFor(Hash()(key));
+		Future future;
+		std::shared_ptr<std::promise<Pointer>> load;
+		if (!claim(shard, key, future, load))
+			return future;
+
+		pool.submit([&shard, key, create, load]() {
+			Pointer value;
+			try
+			{
+				value = Pointer(create());
+			}
+			catch (...)
+			{
+				fail(shard, key, *load, std::current_exception());
+				return;
+			}
+
+			// A failed publish has already failed the waiters; nobody to rethrow to
+			try
+			{
+				publish(shard, key, *load, std::move(value));
+			}
+			catch (...)
+			{
+			}
+		});
+		return future;
+	}
+
+	// Insert unless the key is already there; returns the value now cached
+	std::shared_ptr<Value> insert(const Key& key, std::shared_ptr<Value> value)
+	{
+		const size_t hash = Hash()(key);
+		Shard& shard = shardFor(hash);
+		const size_t cost = value ? Cost()(*value) : 0;
+
+		std::unique_lock<std::shared_mutex> lock(shard.mutex);
+		return insertLocked(shard, key, std::move(value), cost);
+	}
+
+	void erase(const Key& key)
+	{
+		Shard& shard = shardFor(Hash()(key));
+
+		std::unique_lock<std::shared_mutex> lock(shard.mutex);
+		auto it = shard.index.find(key);
+		if (it != shard.index.end())
+			remove(shard, it->second.slot);
+	}
+
+	void clear()
+	{
+		for (unsigned s = 0; s < m_shardCount; ++s)
+		{
+			Shard& shard = m_shards[s];
+			std::unique_lock<std::shared_mutex> lock(shard.mutex);
+			shard.index.clear();
+			shard.clock.clear();
+			shard.hand = 0;
+			shard.cost = 0;
+		}
+	}
+
+	size_t size() const
+	{
+		size_t count = 0;
+		for (unsigned s = 0; s < m_shardCount; ++s)
+		{
+			std::shared_lock<std::shared_mutex> lock(m_shards[s].mutex);
+			count += m_shards[s].index.size();
+		}
+		return count;
+	}
+
+	size_t cost() const
+	{
+		size_t total = 0;
+		for (unsigned s = 0; s < m_shardCount; ++s)
+		{
+			std::shared_lock<std::shared_mutex> lock(m_shards[s].mutex);
+			total += m_shards[s].cost;
+		}
+		return total;
+	}
+
+	size_t evictions() const
+	{
+		size_t total = 0;
+		for (unsigned s = 0; s < m_shardCount; ++s)
+			total += m_shards[s].evictions.load(std::memory_order_relaxed);
+		return total;
+	}
+
+private:
+	struct Entry
+	{
+		Entry(std::shared_ptr<Value> v, size_t c) : value(std::move(v)), cost(c), slot(0), referenced(false) { }
+
+		std::shared_ptr<Value> value;
+		size_t cost;
+		// Position in the shard's clock ring
+		size_t slot;
+		// Written under the shared lock by concurrent hits, hence atomic
+		mutable std::atomic<bool> referenced;
+	};
+
+	typedef std::unordered_map<Key, Entry, Hash> Index;
+	typedef typename Index::value_type Node;
+
+	// Own cache line per shard so one shard's lock traffic does not slow the next
+	struct alignas(64) Shard
+	{
+		mutable std::shared_mutex mutex;
+		Index index;
+		// Element addresses in an unordered_map survive rehashing, iterators do not
+		std::vector<Node*> clock;
+		size_t hand = 0;
+		size_t cost = 0;
+		size_t budget = 0;
+		std::atomic<size_t> evictions{ 0 };
+		// Loads in progress; a key is either here or in index, never both
+		std::unordered_map<Key, Future, Hash> loading;
+	};
+
+	static Future ready(Pointer value)
+	{
+		std::promise<Pointer> promise;
+		promise.set_value(std::move(value));
+		return promise.get_future().share();
+	}
+
+	// Returns true if the caller owns the load of key (and must publish or fail
+	// it); otherwise future already has, or will get, the value
+	static bool claim(Shard& shard, const Key& key, Future& future, std::shared_ptr<std::promise<Pointer>>& load)
+	{
+		std::unique_lock<std::shared_mutex> lock(shard.mutex);
+
+		auto it = shard.index.find(key);
+		if (it != shard.index.end())
+		{
+			it->second.referenced.store(true, std::memory_order_relaxed);
+			future = ready(it->second.value);
+			return false;
+		}
+
+		auto pending = shard.loading.find(key);
+		if (pending != shard.loading.end())
+		{
+			future = pending->second;
+			return false;
+		}
+
+		load = std::make_shared<std::promise<Pointer>>();
+		future = load->get_future().share();
+		shard.loading.emplace(key, future);
+		return true;
+	}
+
+	// Either way the loading entry is cleared and the waiters are released: if
+	// costing or inserting throws (bad_alloc...) they get the exception, which
+	// is then rethrown to the caller
+	static Pointer publish(Shard& shard, const Key& key, std::promise<Pointer>& load, Pointer value)
+	{
+		try
+		{
+			const size_t cost = value ? Cost()(*value) : 0;
+			std::unique_lock<std::shared_mutex> lock(shard.mutex);
+			value = insertLocked(shard, key, std::move(value), cost);
+			shard.loading.erase(key);
+		}
+		catch (...)
+		{
+			fail(shard, key, load, std::current_exception());
+			throw;
+		}
+
+		// Waiters wake up outside the shard lock
+		load.set_value(value);
+		return value;
+	}
+
+	static void fail(Shard& shard, const Key& key, std::promise<Pointer>& load, std::exception_ptr error)
+	{
+		{
+			std::unique_lock<std::shared_mutex> lock(shard.mutex);
+			shard.loading.erase(key);
+		}
+		load.set_exception(error);
+	}
+
+	static Pointer insertLocked(Shard& shard, const Key& key, Pointer value, size_t cost)
+	{
+		auto it = shard.index.find(key);
+		if (it != shard.index.end())
+		{
+			it->second.referenced.store(true, std::memory_order_relaxed);
+			return it->second.value;
+		}
+
+		evict(shard, cost);
+
+		// Grow the clock first, so a throwing allocation leaves the shard untouched
+		shard.clock.reserve(shard.clock.size() + 1);
+		auto inserted = shard.index.emplace(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(value, cost)).first;
+		inserted->second.slot = shard.clock.size();
+		shard.clock.push_back(&*inserted);
+		shard.cost += cost;
+		return value;
+	}
+
+	Shard& shardFor(size_t hash) const
+	{
+		// Top bits pick the shard, the map uses the whole hash for its buckets
+		return m_shards[(hash >> (sizeof(size_t) * 4)) % m_shardCount];
+	}
+
+	// CLOCK: sweep until the new entry fits, giving referenced entries a second chance
+	static void evict(Shard& shard, size_t incoming)
+	{
+		while (!shard.clock.empty() && shard.cost + incoming > shard.budget)
+		{
+			if (shard.hand >= shard.clock.size())
+				shard.hand = 0;
+
+			Node* node = shard.clock[shard.hand];
+			if (node->second.referenced.exchange(false, std::memory_order_relaxed))
+			{
+				++shard.hand;
+				continue;
+			}
+
+			remove(shard, shard.hand);
+			shard.evictions.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	// Swap-remove from the clock ring, then drop from the index
+	static void remove(Shard& shard, size_t c)
+	{
+		Node* node = shard.clock[c];
+		shard.cost -= node->second.cost;
+		shard.clock[c] = shard.clock.back();
+		shard.clock[c]->second.slot = c;
+		shard.clock.pop_back();
+		shard.index.erase(shard.index.find(node->first));
+	}
+
+private:
+	unsigned m_shardCount;
+	std::unique_ptr<Shard[]> m_shards;
+};
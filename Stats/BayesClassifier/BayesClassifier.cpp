@@ -1,6 +1,11 @@
 #include <sstream>
+#include <fstream>
 #include <locale>
+#include <math.h>
+#include <string.h>
 #include "BayesClassifier.h"
+#include "BayesModel.h"
+#include "NaiveBayes.h"
 
 using namespace mhe;
 
@@ -10,12 +15,14 @@ BayesClassifier::BayesClassifier()
 	, m_responses({})
 	, m_wordList({})
 	, m_responseList({})
+	, m_sampleCount(0)
 {
 }
 
 void BayesClassifier::train(const std::string &sample, const std::string &response)
 {
 	checkResponse(response);
+	m_sampleCount++;
 
 	// Get list of sample broken down into tokens
 	const std::vector<std::string> tokens = splitString(sample);
@@ -28,12 +35,47 @@ void BayesClassifier::train(const std::string &sample, const std::string &respon
 
 }
 
+void BayesClassifier::predict(const std::string &input, std::string &output) const
+{
+	if (m_responseList.empty())
+	{
+		output.clear();
+		return;
+	}
+
+	// Start from the log prior of every response
+	std::vector<float> scores(m_responseList.size());
+	for (const auto &response : m_responses)
+		scores[response.second.index] = log(static_cast<float>(response.second.count) / m_sampleCount);
+
+	// Unknown tokens carry no evidence and are skipped
+	const std::vector<unsigned int> tokenCounts = responseTokenCounts();
+	for (const auto &token : splitString(input))
+	{
+		const auto word = m_dictionary.find(toLower(token));
+		if (word == m_dictionary.end())
+			continue;
+
+		for (unsigned int r = 0; r < scores.size(); ++r)
+			scores[r] += logProbability(word->second.counts, r, tokenCounts[r]);
+	}
+
+	unsigned int best = 0;
+	for (unsigned int r = 1; r < scores.size(); ++r)
+	{
+		if (scores[r] > scores[best])
+			best = r;
+	}
+
+	output = m_responseList[best];
+}
+
 void BayesClassifier::checkResponse(const std::string &response)
 {
 	if (m_responses.find(response) == m_responses.end())
 	{
 		// Create new response field
-		ResponseData newRespData = {1, 0};
+		ResponseData newRespData = {static_cast<unsigned int>(m_responseList.size()), 1, 0};
 		m_responses.emplace(response, newRespData);
 		m_responseList.emplace_back(response);
 	}
@@ -43,23 +85,22 @@ void BayesClassifier::checkResponse(const std::string &response)
 	}
 }
 
-std::vector<std::string> BayesClassifier::splitString(const std::string &str, char delimiter = ' ')
+std::vector<std::string> BayesClassifier::splitString(const std::string &str, char delimiter) const
 {
 	// TODO: delimiter
 
 	std::vector<std::string> wordList;
 	std::istringstream iss(str);
-	while (iss)
+	std::string word;
+	while (iss >> word)
 	{
-		std::string word;
-		iss >> word;
 		wordList.emplace_back(word);
 	}
 
 	return wordList;
 }
 
-std::string BayesClassifier::toLower(const std::string &str)
+std::string BayesClassifier::toLower(const std::string &str) const
 {
 	std::string newStr;
 	std::locale loc;
@@ -70,23 +111,153 @@ std::string BayesClassifier::toLower(const std::string &str)
 
 void BayesClassifier::increment(const std::string &token, const std::string &response)
 {
-	m_responses[response].tokenCount++;
-	
-	if (m_dictionary.find(token) == m_dictionary.end())
+	ResponseData &responseData = m_responses[response];
+	responseData.tokenCount++;
+
+	auto word = m_dictionary.find(token);
+	if (word == m_dictionary.end())
 	{
 		WordData newWordData = {
 			token,
-			response,
-			1
+			std::vector<unsigned int>(m_responseList.size(), 0)
 		};
-		m_dictionary.emplace(token, newWordData);
+		word = m_dictionary.emplace(token, newWordData).first;
 		m_wordList.emplace_back(token);
 	}
-	else
+
+	// Responses seen after this word was added extend its counts lazily
+	std::vector<unsigned int> &counts = word->second.counts;
+	if (counts.size() <= responseData.index)
+		counts.resize(m_responseList.size(), 0);
+
+	counts[responseData.index]++;
+}
+
+float BayesClassifier::logProbability(const std::vector<unsigned int> &counts, unsigned int responseIndex, unsigned int tokenCount) const
+{
+	// Multinomial P(token | response); NaiveBayes.h has the other variants
+	const unsigned int count = responseIndex < counts.size() ? counts[responseIndex] : 0;
+	return LaplaceSmoothing::logProbability(static_cast<float>(count), static_cast<float>(tokenCount), static_cast<float>(m_dictionary.size()));
+}
+
+std::vector<unsigned int> BayesClassifier::responseTokenCounts() const
+{
+	// One pass over the map, so per token lookups are by position instead of by name
+	std::vector<unsigned int> tokenCounts(m_responseList.size(), 0);
+	for (const auto &response : m_responses)
+		tokenCounts[response.second.index] = response.second.tokenCount;
+	return tokenCounts;
+}
+
+bool BayesClassifier::save(const std::string &path) const
+{
+	std::vector<char> bytes;
+	serialize(bytes);
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+
+	file.write(bytes.data(), bytes.size());
+	return static_cast<bool>(file);
+}
+
+void BayesClassifier::serialize(std::vector<char> &bytes) const
+{
+	const uint32_t numTokens = static_cast<uint32_t>(m_wordList.size());
+	const uint32_t numResponses = static_cast<uint32_t>(m_responseList.size());
+	const uint64_t matrixSize = static_cast<uint64_t>(numTokens) * numResponses;
+
+	// Keep the index at most half full so probe sequences stay short. 2^31 slots
+	// still leave room for any vocabulary a uint32_t token id can number.
+	uint32_t hashCapacity = 16;
+	while (hashCapacity < static_cast<uint64_t>(numTokens) * 2 && hashCapacity < 0x80000000u)
+		hashCapacity <<= 1;
+
+	uint64_t stringBytes = 0;
+	for (const auto &word : m_wordList)
+		stringBytes += word.size();
+	for (const auto &response : m_responseList)
+		stringBytes += response.size();
+
+	// Lay out sections back to back, each on its own alignment boundary
+	auto align = [](uint64_t offset) {
+		return (offset + BAYES_MODEL_ALIGNMENT - 1) & ~static_cast<uint64_t>(BAYES_MODEL_ALIGNMENT - 1);
+	};
+
+	BayesModelHeader header = {};
+	header.magic = BAYES_MODEL_MAGIC;
+	header.version = BAYES_MODEL_VERSION;
+	header.numTokens = numTokens;
+	header.numResponses = numResponses;
+	header.hashCapacity = hashCapacity;
+	header.sampleCount = m_sampleCount;
+	header.stringOffsetsOffset = align(sizeof(BayesModelHeader));
+	header.stringDataOffset = align(header.stringOffsetsOffset + (static_cast<uint64_t>(numTokens) + numResponses + 1) * sizeof(uint32_t));
+	header.hashIndexOffset = align(header.stringDataOffset + stringBytes);
+	header.responsesOffset = align(header.hashIndexOffset + hashCapacity * sizeof(BayesModelSlot));
+	header.countsOffset = align(header.responsesOffset + numResponses * sizeof(BayesModelResponse));
+	header.logProbOffset = align(header.countsOffset + matrixSize * sizeof(uint32_t));
+	header.fileSize = align(header.logProbOffset + matrixSize * sizeof(float));
+
+	bytes.assign(header.fileSize, 0);
+	char *data = bytes.data();
+	memcpy(data, &header, sizeof(header));
+
+	// String table
+	uint32_t *stringOffsets = reinterpret_cast<uint32_t *>(data + header.stringOffsetsOffset);
+	char *stringData = data + header.stringDataOffset;
+	uint32_t stringOffset = 0;
+	auto appendString = [&](const std::string &str) {
+		*stringOffsets++ = stringOffset;
+		memcpy(stringData + stringOffset, str.data(), str.size());
+		stringOffset += static_cast<uint32_t>(str.size());
+	};
+	for (const auto &word : m_wordList)
+		appendString(word);
+	for (const auto &response : m_responseList)
+		appendString(response);
+	*stringOffsets = stringOffset;
+
+	// Hash index
+	BayesModelSlot *slots = reinterpret_cast<BayesModelSlot *>(data + header.hashIndexOffset);
+	for (uint32_t s = 0; s < hashCapacity; ++s)
+		slots[s].token = BAYES_MODEL_EMPTY_SLOT;
+
+	for (uint32_t t = 0; t < numTokens; ++t)
+	{
+		const std::string &word = m_wordList[t];
+		const uint64_t hash = hashToken(word.data(), word.size());
+		uint32_t slot = static_cast<uint32_t>(hash) & (hashCapacity - 1);
+		while (slots[slot].token != BAYES_MODEL_EMPTY_SLOT)
+			slot = (slot + 1) & (hashCapacity - 1);
+
+		slots[slot].hash = hash;
+		slots[slot].token = t;
+	}
+
+	// Responses
+	BayesModelResponse *responses = reinterpret_cast<BayesModelResponse *>(data + header.responsesOffset);
+	for (const auto &response : m_responses)
+	{
+		BayesModelResponse &record = responses[response.second.index];
+		record.count = response.second.count;
+		record.tokenCount = response.second.tokenCount;
+		record.logPrior = log(static_cast<float>(response.second.count) / m_sampleCount);
+	}
+
+	// Count and log probability matrices, [token][response]
+	uint32_t *counts = reinterpret_cast<uint32_t *>(data + header.countsOffset);
+	float *logProbs = reinterpret_cast<float *>(data + header.logProbOffset);
+	const std::vector<unsigned int> tokenCounts = responseTokenCounts();
+	for (uint32_t t = 0; t < numTokens; ++t)
 	{
-		WordData wd = m_dictionary[token];
-		// TODO:
+		const WordData &word = m_dictionary.at(m_wordList[t]);
+		for (uint32_t r = 0; r < numResponses; ++r)
+		{
+			const size_t i = static_cast<size_t>(t) * numResponses + r;
+			counts[i] = r < word.counts.size() ? word.counts[r] : 0;
+			logProbs[i] = logProbability(word.counts, r, tokenCounts[r]);
+		}
 	}
-	
-	
-}
\ No newline at end of file
+}
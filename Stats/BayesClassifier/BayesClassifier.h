@@ -20,16 +20,25 @@ public:
 	void train(const std::string &sample, const std::string &response);
 	void predict(const std::string &input, std::string &output) const;
 
+	// Write the trained model in the binary format described in BayesModel.h
+	// so it can be mapped back with BayesModel::open instead of retraining
+	bool save(const std::string &path) const;
+	void serialize(std::vector<char> &bytes) const;
+
 private:
 	void checkResponse(const std::string &response);
-	std::vector<std::string> splitString(const std::string &str, char delimiter = ' ');
-	std::string toLower(const std::string &str);
+	std::vector<std::string> splitString(const std::string &str, char delimiter = ' ') const;
+	std::string toLower(const std::string &str) const;
 	void increment(const std::string &token, const std::string &response);
-	void compute();
+	float logProbability(const std::vector<unsigned int> &counts, unsigned int responseIndex, unsigned int tokenCount) const;
+
+	// Token count of every response, indexed like m_responseList
+	std::vector<unsigned int> responseTokenCounts() const;
 
 private:
 	struct ResponseData
 	{
+		unsigned int index;
 		unsigned int count;
 		unsigned int tokenCount;
 	};
@@ -37,8 +46,9 @@ private:
 	struct WordData
 	{
 		std::string word;
-		std::string response;
-		unsigned int count;
+
+		// Per response, indexed like m_responseList
+		std::vector<unsigned int> counts;
 	};
 
 private:
@@ -48,5 +58,6 @@ private:
 	std::vector<std::string> m_wordList;
 	std::vector<std::string> m_responseList;
 
+	unsigned int m_sampleCount;
 };
 } // mhe
@@ -0,0 +1,136 @@
+#include <fstream>
+#include <iomanip>
+#include "BayesEvaluation.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace mhe;
+
+bool LabelledCorpus::load(const std::string &path)
+{
+	std::ifstream file(path);
+	if (!file)
+		return false;
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		const size_t tab = line.find('\t');
+		if (tab == std::string::npos)
+			continue;
+
+		add(line.substr(0, tab), line.substr(tab + 1));
+	}
+
+	return true;
+}
+
+void LabelledCorpus::add(const std::string &label, const std::string &text)
+{
+	Sample sample = {m_arena.size(), static_cast<uint32_t>(text.size()), labelIndex(label)};
+	m_arena.insert(m_arena.end(), text.begin(), text.end());
+	m_samples.push_back(sample);
+}
+
+uint32_t LabelledCorpus::labelIndex(const std::string &label)
+{
+	for (uint32_t l = 0; l < m_labels.size(); ++l)
+	{
+		if (m_labels[l] == label)
+			return l;
+	}
+
+	m_labels.push_back(label);
+	return static_cast<uint32_t>(m_labels.size() - 1);
+}
+
+std::string_view LabelledCorpus::sampleText(size_t sample) const
+{
+	const Sample &s = m_samples[sample];
+	return std::string_view(m_arena.data() + s.offset, s.length);
+}
+
+size_t mhe::peakMemoryUsage()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.PeakWorkingSetSize;
+	return 0;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#ifdef __APPLE__
+	return static_cast<size_t>(usage.ru_maxrss);
+#else
+	return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+void EvaluationReport::finalize()
+{
+	const size_t numLabels = labels.size();
+	precision.assign(numLabels, 0.0);
+	recall.assign(numLabels, 0.0);
+
+	uint64_t correct = 0;
+	for (size_t l = 0; l < numLabels; ++l)
+	{
+		const uint64_t truePositives = confusion[l * numLabels + l];
+		correct += truePositives;
+
+		uint64_t predictedAs = 0;
+		for (size_t actual = 0; actual < numLabels; ++actual)
+			predictedAs += confusion[actual * numLabels + l];
+
+		precision[l] = predictedAs ? static_cast<double>(truePositives) / predictedAs : 0.0;
+		recall[l] = support[l] ? static_cast<double>(truePositives) / support[l] : 0.0;
+	}
+
+	accuracy = samples ? static_cast<double>(correct) / samples : 0.0;
+}
+
+void EvaluationReport::print(std::ostream &out) const
+{
+	const size_t numLabels = labels.size();
+
+	// Formatting below is restored on return, the caller's stream is left as it was
+	const std::ios_base::fmtflags flags = out.flags();
+	const std::streamsize precisionDigits = out.precision();
+
+	out << folds << "-fold cross validation over " << samples << " samples\n";
+	out << std::fixed << std::setprecision(4);
+	out << "accuracy: " << accuracy << "\n\n";
+
+	out << std::left << std::setw(20) << "label" << std::right
+		<< std::setw(10) << "precision" << std::setw(10) << "recall" << std::setw(10) << "support" << "\n";
+	for (size_t l = 0; l < numLabels; ++l)
+	{
+		out << std::left << std::setw(20) << labels[l] << std::right
+			<< std::setw(10) << precision[l] << std::setw(10) << recall[l] << std::setw(10) << support[l] << "\n";
+	}
+
+	out << "\nconfusion (rows actual, columns predicted)\n";
+	for (size_t actual = 0; actual < numLabels; ++actual)
+	{
+		for (size_t predicted = 0; predicted < numLabels; ++predicted)
+			out << std::setw(8) << confusion[actual * numLabels + predicted];
+		out << "\n";
+	}
+
+	out << std::setprecision(1);
+	out << "\ntrain:   " << trainSamplesPerSecond << " samples/s\n";
+	out << "predict: " << predictSamplesPerSecond << " samples/s\n";
+	out << "wall:    " << std::setprecision(3) << wallSeconds << " s\n";
+	out << "peak memory: " << peakMemoryBytes / (1024 * 1024) << " MB\n";
+
+	out.flags(flags);
+	out.precision(precisionDigits);
+}
@@ -0,0 +1,237 @@
+// k-fold cross validation and benchmarking for the Bayes classifiers
+//
+// The labelled corpus is loaded once into a single text arena; folds only hold
+// sample indices. Folds train and predict in parallel, each on its own
+// classifier, and the report merges their confusion matrices and timings.
+//
+// Any classifier with train(sample, response) and predict(input, output) can be
+// evaluated, so the same driver benchmarks BayesClassifier and
+// HashedBayesClassifier alike.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "BayesClassifier.h"
+
+namespace mhe
+{
+
+class LabelledCorpus
+{
+public:
+	LabelledCorpus() = default;
+	~LabelledCorpus() = default;
+
+	// One sample per line: "label<TAB>text"; lines without a tab are skipped
+	bool load(const std::string &path);
+	void add(const std::string &label, const std::string &text);
+
+	size_t size() const { return m_samples.size(); }
+	size_t labelCount() const { return m_labels.size(); }
+	const std::string &label(uint32_t index) const { return m_labels[index]; }
+
+	uint32_t sampleLabel(size_t sample) const { return m_samples[sample].label; }
+	// View into the arena, valid until the next add()
+	std::string_view sampleText(size_t sample) const;
+	size_t arenaBytes() const { return m_arena.capacity(); }
+
+private:
+	uint32_t labelIndex(const std::string &label);
+
+private:
+	struct Sample
+	{
+		uint64_t offset;
+		uint32_t length;
+		uint32_t label;
+	};
+
+private:
+	std::vector<char> m_arena;
+	std::vector<Sample> m_samples;
+	std::vector<std::string> m_labels;
+};
+
+struct EvaluationReport
+{
+	unsigned int folds = 0;
+	size_t samples = 0;
+	std::vector<std::string> labels;
+
+	// confusion[actual * labels + predicted]; predictions naming no known label
+	// are left out of the matrix but still count against accuracy and recall
+	std::vector<uint64_t> confusion;
+	std::vector<uint64_t> support;
+
+	double accuracy = 0.0;
+	std::vector<double> precision;
+	std::vector<double> recall;
+
+	// Summed over folds, so throughput is per worker rather than wall clock
+	double trainSeconds = 0.0;
+	double predictSeconds = 0.0;
+	double trainSamplesPerSecond = 0.0;
+	double predictSamplesPerSecond = 0.0;
+	double wallSeconds = 0.0;
+	size_t peakMemoryBytes = 0;
+
+	void finalize();
+	void print(std::ostream &out) const;
+};
+
+// Peak resident set size of this process
+size_t peakMemoryUsage();
+
+// Classifiers with a separate compute step (NaiveBayes) get it between training
+// and prediction; the others are ready as soon as they are trained
+template <class Classifier>
+inline auto finishTraining(Classifier &classifier, int) -> decltype(classifier.compute(), void())
+{
+	classifier.compute();
+}
+
+template <class Classifier>
+inline void finishTraining(Classifier &, long)
+{
+}
+
+template <class Classifier = BayesClassifier>
+EvaluationReport crossValidate(const LabelledCorpus &corpus, unsigned int folds = 5, unsigned int threads = 0,
+	const std::function<Classifier()> &makeClassifier = []() { return Classifier(); });
+
+
+/* Inline implementation */
+template <class Classifier>
+inline EvaluationReport crossValidate(const LabelledCorpus &corpus, unsigned int folds, unsigned int threads,
+	const std::function<Classifier()> &makeClassifier)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	EvaluationReport report;
+	const size_t numLabels = corpus.labelCount();
+	folds = std::max(2u, std::min<unsigned int>(folds, static_cast<unsigned int>(std::max<size_t>(corpus.size(), 2))));
+	report.folds = folds;
+	report.samples = corpus.size();
+	for (uint32_t l = 0; l < numLabels; ++l)
+		report.labels.push_back(corpus.label(l));
+
+	struct FoldResult
+	{
+		std::vector<uint64_t> confusion;
+		std::vector<uint64_t> support;
+		double trainSeconds = 0.0;
+		double predictSeconds = 0.0;
+		size_t trained = 0;
+		size_t predicted = 0;
+	};
+	std::vector<FoldResult> results(folds);
+
+	// Sample i is held out by fold i % folds
+	auto runFold = [&](unsigned int fold) {
+		FoldResult &result = results[fold];
+		result.confusion.assign(numLabels * numLabels, 0);
+		result.support.assign(numLabels, 0);
+		Classifier classifier = makeClassifier();
+
+		// The classifiers take std::string; one reused buffer per fold keeps the
+		// copy out of the allocator once it has grown to the longest sample
+		std::string text;
+		const size_t heldOut = fold < corpus.size() ? (corpus.size() - fold + folds - 1) / folds : 0;
+		std::vector<std::string> outputs(heldOut);
+
+		const Clock::time_point trainStart = Clock::now();
+		for (size_t s = 0; s < corpus.size(); ++s)
+		{
+			if (s % folds == fold)
+				continue;
+			const std::string_view sample = corpus.sampleText(s);
+			text.assign(sample.data(), sample.size());
+			classifier.train(text, corpus.label(corpus.sampleLabel(s)));
+			result.trained++;
+		}
+		finishTraining(classifier, 0);
+		const Clock::time_point predictStart = Clock::now();
+
+		for (size_t s = fold, i = 0; s < corpus.size(); s += folds, ++i)
+		{
+			const std::string_view sample = corpus.sampleText(s);
+			text.assign(sample.data(), sample.size());
+			classifier.predict(text, outputs[i]);
+		}
+
+		const Clock::time_point end = Clock::now();
+		result.trainSeconds = std::chrono::duration<double>(predictStart - trainStart).count();
+		result.predictSeconds = std::chrono::duration<double>(end - predictStart).count();
+
+		// Outputs are mapped back to label ids after the timed loop
+		for (size_t s = fold, i = 0; s < corpus.size(); s += folds, ++i)
+		{
+			const uint32_t actual = corpus.sampleLabel(s);
+			result.support[actual]++;
+			result.predicted++;
+
+			uint32_t predicted = static_cast<uint32_t>(numLabels);
+			for (uint32_t l = 0; l < numLabels; ++l)
+			{
+				if (corpus.label(l) == outputs[i])
+				{
+					predicted = l;
+					break;
+				}
+			}
+			if (predicted < numLabels)
+				result.confusion[actual * numLabels + predicted]++;
+		}
+	};
+
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	threads = std::min(threads, folds);
+
+	const Clock::time_point wallStart = Clock::now();
+	std::vector<std::thread> workers;
+	for (unsigned int t = 0; t < threads; ++t)
+	{
+		workers.emplace_back([&, t]() {
+			for (unsigned int fold = t; fold < folds; fold += threads)
+				runFold(fold);
+		});
+	}
+	for (auto &worker : workers)
+		worker.join();
+	report.wallSeconds = std::chrono::duration<double>(Clock::now() - wallStart).count();
+
+	report.confusion.assign(numLabels * numLabels, 0);
+	report.support.assign(numLabels, 0);
+	size_t trained = 0;
+	size_t predicted = 0;
+	for (const auto &result : results)
+	{
+		for (size_t i = 0; i < report.confusion.size(); ++i)
+			report.confusion[i] += result.confusion[i];
+		for (size_t l = 0; l < numLabels; ++l)
+			report.support[l] += result.support[l];
+		report.trainSeconds += result.trainSeconds;
+		report.predictSeconds += result.predictSeconds;
+		trained += result.trained;
+		predicted += result.predicted;
+	}
+
+	report.trainSamplesPerSecond = report.trainSeconds > 0.0 ? trained / report.trainSeconds : 0.0;
+	report.predictSamplesPerSecond = report.predictSeconds > 0.0 ? predicted / report.predictSeconds : 0.0;
+	report.peakMemoryBytes = peakMemoryUsage();
+	report.finalize();
+
+	return report;
+}
+
+} // mhe
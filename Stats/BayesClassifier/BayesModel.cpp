@@ -0,0 +1,297 @@
+#include <ctype.h>
+#include <string.h>
+#include "BayesModel.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace mhe;
+
+namespace
+{
+	// [offset, offset + length) inside a file of size bytes, without overflowing
+	bool sectionFits(uint64_t offset, uint64_t length, uint64_t size)
+	{
+		return offset <= size && length <= size - offset;
+	}
+}
+
+uint64_t mhe::hashToken(const char *token, size_t length)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < length; ++i)
+	{
+		hash ^= static_cast<unsigned char>(tolower(static_cast<unsigned char>(token[i])));
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+BayesModel::BayesModel()
+	: m_mapping(nullptr)
+	, m_mappingSize(0)
+#ifdef _WIN32
+	, m_fileHandle(nullptr)
+	, m_mappingHandle(nullptr)
+#endif
+	, m_header(nullptr)
+	, m_stringOffsets(nullptr)
+	, m_stringData(nullptr)
+	, m_slots(nullptr)
+	, m_responses(nullptr)
+	, m_counts(nullptr)
+	, m_logProbs(nullptr)
+{
+}
+
+BayesModel::~BayesModel()
+{
+	close();
+}
+
+bool BayesModel::open(const std::string &path)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!data)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	m_fileHandle = file;
+	m_mappingHandle = mapping;
+	m_mapping = data;
+	m_mappingSize = static_cast<size_t>(size.QuadPart);
+#else
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	// MAP_SHARED so every process serving this model shares the page cache copy
+	void *data = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (data == MAP_FAILED)
+		return false;
+
+	m_mapping = data;
+	m_mappingSize = static_cast<size_t>(info.st_size);
+#endif
+
+	if (!bind(static_cast<const char *>(m_mapping), m_mappingSize))
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+bool BayesModel::attach(std::vector<char> &&bytes)
+{
+	close();
+
+	m_buffer = std::move(bytes);
+	if (!bind(m_buffer.data(), m_buffer.size()))
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void BayesModel::close()
+{
+#ifdef _WIN32
+	if (m_mapping)
+		UnmapViewOfFile(m_mapping);
+	if (m_mappingHandle)
+		CloseHandle(m_mappingHandle);
+	if (m_fileHandle)
+		CloseHandle(m_fileHandle);
+	m_fileHandle = nullptr;
+	m_mappingHandle = nullptr;
+#else
+	if (m_mapping)
+		munmap(m_mapping, m_mappingSize);
+#endif
+	m_mapping = nullptr;
+	m_mappingSize = 0;
+	m_buffer.clear();
+
+	m_header = nullptr;
+	m_stringOffsets = nullptr;
+	m_stringData = nullptr;
+	m_slots = nullptr;
+	m_responses = nullptr;
+	m_counts = nullptr;
+	m_logProbs = nullptr;
+}
+
+bool BayesModel::bind(const char *data, size_t size)
+{
+	if (size < sizeof(BayesModelHeader))
+		return false;
+
+	const BayesModelHeader *header = reinterpret_cast<const BayesModelHeader *>(data);
+	if (header->magic != BAYES_MODEL_MAGIC || header->version != BAYES_MODEL_VERSION)
+		return false;
+	if (header->fileSize != size)
+		return false;
+
+	// Capacity must be a power of two with at least one empty slot to stop probing
+	if (header->hashCapacity == 0 || (header->hashCapacity & (header->hashCapacity - 1)) != 0)
+		return false;
+	if (header->hashCapacity <= header->numTokens)
+		return false;
+
+	// Sections only need to be in bounds; their contents are trusted as written.
+	// Counts are 32 bit, so none of the section lengths below can overflow 64 bits.
+	const uint64_t matrixSize = static_cast<uint64_t>(header->numTokens) * header->numResponses;
+	const uint64_t numStrings = static_cast<uint64_t>(header->numTokens) + header->numResponses;
+	if (!sectionFits(header->stringOffsetsOffset, (numStrings + 1) * sizeof(uint32_t), size)
+		|| !sectionFits(header->stringDataOffset, 0, size)
+		|| !sectionFits(header->hashIndexOffset, static_cast<uint64_t>(header->hashCapacity) * sizeof(BayesModelSlot), size)
+		|| !sectionFits(header->responsesOffset, static_cast<uint64_t>(header->numResponses) * sizeof(BayesModelResponse), size)
+		|| !sectionFits(header->countsOffset, matrixSize * sizeof(uint32_t), size)
+		|| !sectionFits(header->logProbOffset, matrixSize * sizeof(float), size))
+	{
+		return false;
+	}
+
+	m_header = header;
+	m_stringOffsets = reinterpret_cast<const uint32_t *>(data + header->stringOffsetsOffset);
+	m_stringData = data + header->stringDataOffset;
+	m_slots = reinterpret_cast<const BayesModelSlot *>(data + header->hashIndexOffset);
+	m_responses = reinterpret_cast<const BayesModelResponse *>(data + header->responsesOffset);
+	m_counts = reinterpret_cast<const uint32_t *>(data + header->countsOffset);
+	m_logProbs = reinterpret_cast<const float *>(data + header->logProbOffset);
+
+	if (!sectionFits(header->stringDataOffset, m_stringOffsets[numStrings], size))
+	{
+		m_header = nullptr;
+		return false;
+	}
+
+	return true;
+}
+
+const char *BayesModel::string(uint32_t index, uint32_t &length) const
+{
+	length = m_stringOffsets[index + 1] - m_stringOffsets[index];
+	return m_stringData + m_stringOffsets[index];
+}
+
+std::string BayesModel::responseName(uint32_t response) const
+{
+	uint32_t length;
+	const char *name = string(m_header->numTokens + response, length);
+	return std::string(name, length);
+}
+
+uint32_t BayesModel::findToken(const char *token, size_t length) const
+{
+	const uint64_t hash = hashToken(token, length);
+	const uint32_t mask = m_header->hashCapacity - 1;
+
+	for (uint32_t slot = static_cast<uint32_t>(hash) & mask; ; slot = (slot + 1) & mask)
+	{
+		const BayesModelSlot &entry = m_slots[slot];
+		if (entry.token == BAYES_MODEL_EMPTY_SLOT)
+			return BAYES_MODEL_EMPTY_SLOT;
+		if (entry.hash != hash)
+			continue;
+
+		// Full compare so colliding hashes never alias two tokens
+		uint32_t storedLength;
+		const char *stored = string(entry.token, storedLength);
+		if (storedLength != length)
+			continue;
+
+		size_t i = 0;
+		while (i < length && stored[i] == tolower(static_cast<unsigned char>(token[i])))
+			++i;
+		if (i == length)
+			return entry.token;
+	}
+}
+
+void BayesModel::predict(const std::string &input, std::string &output) const
+{
+	const uint32_t numResponses = m_header->numResponses;
+	if (numResponses == 0)
+	{
+		output.clear();
+		return;
+	}
+
+	std::vector<float> scores(numResponses);
+	for (uint32_t r = 0; r < numResponses; ++r)
+		scores[r] = m_responses[r].logPrior;
+
+	// Walk whitespace separated tokens in place, unknown tokens carry no evidence
+	const char *cursor = input.data();
+	const char *end = cursor + input.size();
+	while (cursor < end)
+	{
+		while (cursor < end && isspace(static_cast<unsigned char>(*cursor)))
+			++cursor;
+		const char *tokenBegin = cursor;
+		while (cursor < end && !isspace(static_cast<unsigned char>(*cursor)))
+			++cursor;
+		if (cursor == tokenBegin)
+			break;
+
+		const uint32_t token = findToken(tokenBegin, cursor - tokenBegin);
+		if (token == BAYES_MODEL_EMPTY_SLOT)
+			continue;
+
+		const float *logProbs = logProbabilities(token);
+		for (uint32_t r = 0; r < numResponses; ++r)
+			scores[r] += logProbs[r];
+	}
+
+	uint32_t best = 0;
+	for (uint32_t r = 1; r < numResponses; ++r)
+	{
+		if (scores[r] > scores[best])
+			best = r;
+	}
+
+	output = responseName(best);
+}
@@ -0,0 +1,122 @@
+// Read-only BayesClassifier model served straight from a memory-mapped file
+//
+// File layout (little endian, every section aligned to BAYES_MODEL_ALIGNMENT):
+//   BayesModelHeader
+//   string offsets   uint32[numTokens + numResponses + 1], tokens first
+//   string data      lower case token and response names, not null terminated
+//   hash index       BayesModelSlot[hashCapacity], open addressing, linear probe
+//   responses        BayesModelResponse[numResponses]
+//   counts           uint32[numTokens][numResponses]
+//   log probability  float[numTokens][numResponses]
+//
+// Nothing is parsed on open; lookups read the mapped pages directly, so several
+// processes mapping the same file share one copy of the model.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace mhe
+{
+
+static const uint32_t BAYES_MODEL_MAGIC = 0x4245484D; // "MHEB"
+static const uint32_t BAYES_MODEL_VERSION = 1;
+static const uint32_t BAYES_MODEL_ALIGNMENT = 64;
+static const uint32_t BAYES_MODEL_EMPTY_SLOT = 0xFFFFFFFF;
+
+struct BayesModelHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t numTokens;
+	uint32_t numResponses;
+	uint32_t hashCapacity;
+	uint32_t sampleCount;
+
+	uint64_t stringOffsetsOffset;
+	uint64_t stringDataOffset;
+	uint64_t hashIndexOffset;
+	uint64_t responsesOffset;
+	uint64_t countsOffset;
+	uint64_t logProbOffset;
+	uint64_t fileSize;
+};
+
+struct BayesModelSlot
+{
+	uint64_t hash;
+	uint32_t token;
+	uint32_t padding;
+};
+
+struct BayesModelResponse
+{
+	uint32_t count;
+	uint32_t tokenCount;
+	float logPrior;
+	float padding;
+};
+
+// FNV-1a over the lower cased token, shared by the writer and the reader
+uint64_t hashToken(const char *token, size_t length);
+
+class BayesModel
+{
+public:
+	BayesModel();
+	~BayesModel();
+
+	BayesModel(const BayesModel &) = delete;
+	BayesModel &operator=(const BayesModel &) = delete;
+
+	// Map a file written by BayesClassifier::save
+	bool open(const std::string &path);
+
+	// Serve an in-memory image produced by BayesClassifier::serialize
+	bool attach(std::vector<char> &&bytes);
+
+	void close();
+	bool isOpen() const { return m_header != nullptr; }
+
+	void predict(const std::string &input, std::string &output) const;
+
+	// Token id, or BAYES_MODEL_EMPTY_SLOT if the (lower case) token is unknown
+	uint32_t findToken(const char *token, size_t length) const;
+
+	uint32_t tokenCount() const { return m_header->numTokens; }
+	uint32_t responseCount() const { return m_header->numResponses; }
+	std::string responseName(uint32_t response) const;
+	const char *tokenName(uint32_t token, uint32_t &length) const { return string(token, length); }
+
+	const BayesModelResponse &response(uint32_t response) const { return m_responses[response]; }
+	uint32_t count(uint32_t token, uint32_t response) const { return m_counts[static_cast<size_t>(token) * m_header->numResponses + response]; }
+	const float *logProbabilities(uint32_t token) const { return m_logProbs + static_cast<size_t>(token) * m_header->numResponses; }
+
+private:
+	bool bind(const char *data, size_t size);
+	const char *string(uint32_t index, uint32_t &length) const;
+
+private:
+	// Backing storage: either a mapping or an owned buffer
+	void *m_mapping;
+	size_t m_mappingSize;
+#ifdef _WIN32
+	void *m_fileHandle;
+	void *m_mappingHandle;
+#endif
+	std::vector<char> m_buffer;
+
+	// Views into the backing storage
+	const BayesModelHeader *m_header;
+	const uint32_t *m_stringOffsets;
+	const char *m_stringData;
+	const BayesModelSlot *m_slots;
+	const BayesModelResponse *m_responses;
+	const uint32_t *m_counts;
+	const float *m_logProbs;
+};
+
+} // mhe
@@ -0,0 +1,78 @@
+#include <atomic>
+#include "ConcurrentBayesClassifier.h"
+
+using namespace mhe;
+
+ConcurrentBayesClassifier::ConcurrentBayesClassifier(unsigned int publishInterval)
+	: m_publishInterval(publishInterval)
+	, m_snapshot(nullptr)
+{
+}
+
+void ConcurrentBayesClassifier::train(const std::string &sample, const std::string &response)
+{
+	bool due;
+	{
+		std::lock_guard<std::mutex> lock(m_deltaMutex);
+		m_delta.emplace_back(sample, response);
+		due = m_delta.size() >= m_publishInterval;
+	}
+
+	// One publisher at a time; if one is already running it will be triggered
+	// again by a later sample, so nobody queues up behind it
+	if (due)
+	{
+		std::unique_lock<std::mutex> publishing(m_publishMutex, std::try_to_lock);
+		if (publishing.owns_lock())
+			publishLocked();
+	}
+}
+
+void ConcurrentBayesClassifier::publish()
+{
+	std::lock_guard<std::mutex> publishing(m_publishMutex);
+	publishLocked();
+}
+
+void ConcurrentBayesClassifier::publishLocked()
+{
+	// Take the delta; trainers keep appending to a fresh buffer meanwhile
+	{
+		std::lock_guard<std::mutex> lock(m_deltaMutex);
+		m_applying.swap(m_delta);
+	}
+	if (m_applying.empty() && std::atomic_load(&m_snapshot))
+		return;
+
+	for (const auto &sample : m_applying)
+		m_staging.train(sample.first, sample.second);
+	m_applying.clear();
+
+	// Freeze the staging counts into an immutable image readers can share
+	std::vector<char> bytes;
+	m_staging.serialize(bytes);
+
+	std::shared_ptr<BayesModel> model = std::make_shared<BayesModel>();
+	if (!model->attach(std::move(bytes)))
+		return;
+
+	// The previous snapshot is released once its last reader drops it
+	std::atomic_store(&m_snapshot, std::shared_ptr<const BayesModel>(std::move(model)));
+}
+
+std::shared_ptr<const BayesModel> ConcurrentBayesClassifier::snapshot() const
+{
+	return std::atomic_load(&m_snapshot);
+}
+
+void ConcurrentBayesClassifier::predict(const std::string &input, std::string &output) const
+{
+	const std::shared_ptr<const BayesModel> model = snapshot();
+	if (!model)
+	{
+		output.clear();
+		return;
+	}
+
+	model->predict(input, output);
+}
@@ -0,0 +1,60 @@
+// Online training while serving predictions
+//
+// Writers only append their sample to a delta buffer under a short lock. Every
+// publishInterval samples (or on an explicit publish) one publisher takes the
+// delta, applies it to the staging BayesClassifier, freezes that into a BayesModel
+// image and swaps it in. Applying and serializing happen outside the delta lock,
+// so trainers never wait for a publish to finish.
+//
+// Readers only copy the current snapshot pointer, so predictions never wait on
+// training, and a snapshot stays alive as long as a reader still holds it. The
+// copy uses std::atomic_load on shared_ptr. libstdc++ implements that with a small
+// mutex pool, held only for the pointer copy, so it is not strictly lock-free.
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "BayesClassifier.h"
+#include "BayesModel.h"
+
+namespace mhe
+{
+
+class ConcurrentBayesClassifier
+{
+public:
+	explicit ConcurrentBayesClassifier(unsigned int publishInterval = 1024);
+	~ConcurrentBayesClassifier() = default;
+
+	// Writer side, safe to call from any number of threads
+	void train(const std::string &sample, const std::string &response);
+	void publish();
+
+	// Reader side, never waits on training or publishing
+	void predict(const std::string &input, std::string &output) const;
+	std::shared_ptr<const BayesModel> snapshot() const;
+
+private:
+	// Caller holds m_publishMutex
+	void publishLocked();
+
+private:
+	// Samples trained since the last publish
+	std::mutex m_deltaMutex;
+	std::vector<std::pair<std::string, std::string>> m_delta;
+	unsigned int m_publishInterval;
+
+	// Owned by whoever holds m_publishMutex
+	std::mutex m_publishMutex;
+	BayesClassifier m_staging;
+	std::vector<std::pair<std::string, std::string>> m_applying;
+
+	// Only accessed through std::atomic_load / std::atomic_store
+	std::shared_ptr<const BayesModel> m_snapshot;
+};
+
+} // mhe
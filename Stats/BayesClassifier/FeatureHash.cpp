@@ -0,0 +1,65 @@
+#include "FeatureHash.h"
+
+#if defined(__SSE4_1__) || defined(__AVX__)
+#include <smmintrin.h>
+#define MHE_FEATURE_HASH_SSE41
+#endif
+
+using namespace mhe;
+
+uint32_t mhe::hashTokenSpan(const char *data, size_t length)
+{
+	uint32_t hash = FEATURE_HASH_SEED;
+	for (size_t i = 0; i < length; ++i)
+	{
+		hash ^= asciiLower(static_cast<unsigned char>(data[i]));
+		hash *= FEATURE_HASH_PRIME;
+	}
+	return hash;
+}
+
+void mhe::hashTokenBatch(const TokenSpan *tokens, size_t count, uint32_t *hashes)
+{
+	size_t i = 0;
+
+#ifdef MHE_FEATURE_HASH_SSE41
+	// Four tokens per step; lanes whose token already ended keep their hash
+	const __m128i prime = _mm_set1_epi32(FEATURE_HASH_PRIME);
+	const __m128i upperA = _mm_set1_epi32('A' - 1);
+	const __m128i upperZ = _mm_set1_epi32('Z' + 1);
+	const __m128i caseBit = _mm_set1_epi32(0x20);
+
+	for (; i + 4 <= count; i += 4)
+	{
+		const TokenSpan *t = tokens + i;
+		const __m128i lengths = _mm_setr_epi32(t[0].length, t[1].length, t[2].length, t[3].length);
+
+		uint32_t maxLength = t[0].length;
+		for (int lane = 1; lane < 4; ++lane)
+			maxLength = t[lane].length > maxLength ? t[lane].length : maxLength;
+
+		__m128i hash = _mm_set1_epi32(FEATURE_HASH_SEED);
+		for (uint32_t c = 0; c < maxLength; ++c)
+		{
+			const __m128i bytes = _mm_setr_epi32(
+				c < t[0].length ? static_cast<unsigned char>(t[0].data[c]) : 0,
+				c < t[1].length ? static_cast<unsigned char>(t[1].data[c]) : 0,
+				c < t[2].length ? static_cast<unsigned char>(t[2].data[c]) : 0,
+				c < t[3].length ? static_cast<unsigned char>(t[3].data[c]) : 0);
+
+			// ASCII lower case: set bit 5 where 'A' <= byte <= 'Z'
+			const __m128i isUpper = _mm_and_si128(_mm_cmpgt_epi32(bytes, upperA), _mm_cmplt_epi32(bytes, upperZ));
+			const __m128i lower = _mm_or_si128(bytes, _mm_and_si128(isUpper, caseBit));
+
+			const __m128i next = _mm_mullo_epi32(_mm_xor_si128(hash, lower), prime);
+			const __m128i active = _mm_cmpgt_epi32(lengths, _mm_set1_epi32(static_cast<int>(c)));
+			hash = _mm_blendv_epi8(hash, next, active);
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(hashes + i), hash);
+	}
+#endif
+
+	for (; i < count; ++i)
+		hashes[i] = hashTokenSpan(tokens[i].data, tokens[i].length);
+}
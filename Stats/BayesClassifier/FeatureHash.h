@@ -0,0 +1,41 @@
+// Token hashing for the hashing-trick classifiers
+//
+// Tokens are hashed with 32-bit FNV-1a over their ASCII lower case bytes, so
+// "Hello" and "hello" land in the same bucket without building a lowered copy.
+// hashTokenBatch hashes several tokens at once, one per SIMD lane, and gives the
+// same result as hashTokenSpan token by token.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace mhe
+{
+
+static const uint32_t FEATURE_HASH_SEED = 2166136261u;
+static const uint32_t FEATURE_HASH_PRIME = 16777619u;
+
+struct TokenSpan
+{
+	const char *data;
+	uint32_t length;
+};
+
+uint32_t hashTokenSpan(const char *data, size_t length);
+void hashTokenBatch(const TokenSpan *tokens, size_t count, uint32_t *hashes);
+
+// Order dependent mix of two feature hashes, used to build n-gram features
+inline uint32_t combineFeatureHash(uint32_t previous, uint32_t current)
+{
+	uint32_t hash = previous * 0x9E3779B1u;
+	hash ^= current + 0x7F4A7C15u + (hash << 6) + (hash >> 2);
+	return hash;
+}
+
+inline unsigned char asciiLower(unsigned char c)
+{
+	return (c >= 'A' && c <= 'Z') ? static_cast<unsigned char>(c | 0x20) : c;
+}
+
+} // mhe
@@ -0,0 +1,208 @@
+// Single pass feature extraction for the hashing-trick classifiers
+//
+// A FeaturePipeline is composed at compile time from extractors, e.g.
+//
+//     FeaturePipeline<UnigramFeatures, WordNgramFeatures<2>, CharNgramFeatures<4>> pipeline;
+//     classifier.train(pipeline, sample, response);
+//
+// The pipeline walks the input once, lower casing ASCII and collapsing runs of
+// whitespace into a single separator. Every extractor sees each character and
+// each word end and reports feature hashes straight to a sink (typically the
+// classifier's counters), so no token strings or feature vectors are built.
+//
+// HashedBayesClassifier is the sink. BayesClassifier is not: its counters are
+// keyed by the token string (and BayesModel stores that vocabulary), so feeding
+// it hashed features would need a string per feature. Models that want n-gram or
+// shingle features train a HashedBayesClassifier instead.
+//
+// An extractor provides:
+//     template <class Sink> void onChar(unsigned char c, Sink &sink);
+//     template <class Sink> void onWordEnd(uint32_t wordHash, Sink &sink);
+//     void reset();
+
+#pragma once
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <tuple>
+#include "FeatureHash.h"
+
+namespace mhe
+{
+
+// Whole words, hashed exactly like hashTokenSpan
+class UnigramFeatures
+{
+public:
+	template <class Sink> void onChar(unsigned char, Sink &) {}
+	template <class Sink> void onWordEnd(uint32_t wordHash, Sink &sink) { sink(wordHash); }
+	void reset() {}
+};
+
+// Word n-grams of every order from 2 up to N, built from the rolling word history
+template <unsigned int N>
+class WordNgramFeatures
+{
+	static_assert(N >= 2, "WordNgramFeatures needs N >= 2; use UnigramFeatures for single words");
+
+public:
+	WordNgramFeatures() { reset(); }
+
+	template <class Sink> void onChar(unsigned char, Sink &) {}
+	template <class Sink> void onWordEnd(uint32_t wordHash, Sink &sink);
+	void reset() { m_historySize = 0; }
+
+private:
+	// Previous N - 1 word hashes, most recent first
+	uint32_t m_history[N - 1];
+	unsigned int m_historySize;
+};
+
+// Character shingles of length N over the normalized stream (word boundaries
+// included as a single space), using a polynomial rolling hash
+template <unsigned int N>
+class CharNgramFeatures
+{
+	static_assert(N >= 1, "CharNgramFeatures needs N >= 1");
+
+public:
+	CharNgramFeatures();
+
+	template <class Sink> void onChar(unsigned char c, Sink &sink);
+	template <class Sink> void onWordEnd(uint32_t, Sink &) {}
+	void reset() { m_hash = 0; m_filled = 0; m_head = 0; }
+
+private:
+	static const uint32_t BASE = 0x01000193u;
+	static const uint32_t SALT = 0x85EBCA6Bu;
+
+	uint32_t m_hash;
+	uint32_t m_outgoingWeight; // BASE^(N - 1)
+	unsigned char m_window[N];
+	unsigned int m_filled;
+	unsigned int m_head;
+};
+
+template <class... Extractors>
+class FeaturePipeline
+{
+public:
+	// Calls sink(uint32_t feature) for every feature of the input. Extractors
+	// keep per-input state, so use one pipeline per thread
+	template <class Sink> void extract(const char *data, size_t length, Sink &&sink);
+	template <class Sink> void extract(const std::string &input, Sink &&sink) { extract(input.data(), input.size(), sink); }
+
+private:
+	template <class Sink> void dispatchChar(unsigned char c, Sink &sink);
+	template <class Sink> void dispatchWordEnd(uint32_t wordHash, Sink &sink);
+
+private:
+	std::tuple<Extractors...> m_extractors;
+};
+
+
+/* Inline implementation */
+template <unsigned int N>
+template <class Sink>
+inline void WordNgramFeatures<N>::onWordEnd(uint32_t wordHash, Sink &sink)
+{
+	uint32_t ngram = wordHash;
+	for (unsigned int n = 0; n < m_historySize; ++n)
+	{
+		ngram = combineFeatureHash(m_history[n], ngram);
+		sink(ngram);
+	}
+
+	if (m_historySize < N - 1)
+		++m_historySize;
+	for (unsigned int n = m_historySize - 1; n > 0; --n)
+		m_history[n] = m_history[n - 1];
+	m_history[0] = wordHash;
+}
+
+template <unsigned int N>
+inline CharNgramFeatures<N>::CharNgramFeatures()
+{
+	m_outgoingWeight = 1;
+	for (unsigned int i = 1; i < N; ++i)
+		m_outgoingWeight *= BASE;
+	reset();
+}
+
+template <unsigned int N>
+template <class Sink>
+inline void CharNgramFeatures<N>::onChar(unsigned char c, Sink &sink)
+{
+	// Drop the character leaving the window before shifting in the new one
+	if (m_filled == N)
+		m_hash -= m_window[m_head] * m_outgoingWeight;
+	else
+		++m_filled;
+
+	m_hash = m_hash * BASE + c;
+	m_window[m_head] = c;
+	m_head = m_head + 1 == N ? 0 : m_head + 1;
+
+	if (m_filled == N)
+		sink(m_hash ^ SALT);
+}
+
+template <class... Extractors>
+template <class Sink>
+inline void FeaturePipeline<Extractors...>::extract(const char *data, size_t length, Sink &&sink)
+{
+	std::apply([](auto &... extractor) { (extractor.reset(), ...); }, m_extractors);
+
+	uint32_t wordHash = FEATURE_HASH_SEED;
+	bool inWord = false;
+	bool pendingSpace = false;
+
+	for (size_t i = 0; i < length; ++i)
+	{
+		const unsigned char c = static_cast<unsigned char>(data[i]);
+		if (isspace(c))
+		{
+			if (inWord)
+			{
+				dispatchWordEnd(wordHash, sink);
+				wordHash = FEATURE_HASH_SEED;
+				inWord = false;
+				pendingSpace = true;
+			}
+			continue;
+		}
+
+		// Runs of whitespace reach the character extractors as one separator
+		if (pendingSpace)
+		{
+			dispatchChar(' ', sink);
+			pendingSpace = false;
+		}
+
+		const unsigned char lower = asciiLower(c);
+		wordHash = (wordHash ^ lower) * FEATURE_HASH_PRIME;
+		inWord = true;
+		dispatchChar(lower, sink);
+	}
+
+	if (inWord)
+		dispatchWordEnd(wordHash, sink);
+}
+
+template <class... Extractors>
+template <class Sink>
+inline void FeaturePipeline<Extractors...>::dispatchChar(unsigned char c, Sink &sink)
+{
+	std::apply([&](auto &... extractor) { (extractor.onChar(c, sink), ...); }, m_extractors);
+}
+
+template <class... Extractors>
+template <class Sink>
+inline void FeaturePipeline<Extractors...>::dispatchWordEnd(uint32_t wordHash, Sink &sink)
+{
+	std::apply([&](auto &... extractor) { (extractor.onWordEnd(wordHash, sink), ...); }, m_extractors);
+}
+
+} // mhe
@@ -0,0 +1,207 @@
+#include <ctype.h>
+#include <math.h>
+#include <stdexcept>
+#include "HashedBayesClassifier.h"
+
+using namespace mhe;
+
+namespace
+{
+	// Tokens are hashed this many at a time so hashTokenBatch can fill its lanes
+	const size_t TOKEN_BATCH = 64;
+	const unsigned int MAX_NGRAM_ORDER = 8;
+
+	// Validated before any table is sized: shifting by 32 or more is undefined
+	unsigned int checkedMask(unsigned int bucketBits)
+	{
+		if (bucketBits == 0 || bucketBits > 31)
+			throw std::runtime_error("HashedBayesClassifier bucket bits out of range.");
+		return (1u << bucketBits) - 1;
+	}
+}
+
+HashedBayesClassifier::HashedBayesClassifier(unsigned int bucketBits, unsigned int maxResponses, unsigned int ngramOrder)
+	: m_bucketMask(checkedMask(bucketBits))
+	, m_maxResponses(maxResponses)
+	, m_ngramOrder(ngramOrder < 1 ? 1 : (ngramOrder > MAX_NGRAM_ORDER ? MAX_NGRAM_ORDER : ngramOrder))
+	, m_counts((static_cast<size_t>(m_bucketMask) + 1) * maxResponses, 0)
+	, m_logCounts(m_counts.size(), 0.0f)
+	, m_occupied((static_cast<size_t>(m_bucketMask) + 1 + 63) / 64, 0)
+	, m_occupiedCount(0)
+	, m_sampleCount(0)
+{
+	m_responses.reserve(maxResponses);
+}
+
+size_t HashedBayesClassifier::memoryUsage() const
+{
+	return m_counts.size() * (sizeof(uint32_t) + sizeof(float)) + m_occupied.size() * sizeof(uint64_t) + m_responses.capacity() * sizeof(ResponseData);
+}
+
+unsigned int HashedBayesClassifier::responseIndex(const std::string &response)
+{
+	for (unsigned int r = 0; r < m_responses.size(); ++r)
+	{
+		if (m_responses[r].name == response)
+			return r;
+	}
+
+	if (m_responses.size() == m_maxResponses)
+		throw std::runtime_error("HashedBayesClassifier has no room for another response.");
+
+	m_responses.push_back({response, 0, 0});
+	return static_cast<unsigned int>(m_responses.size() - 1);
+}
+
+void HashedBayesClassifier::appendFeatures(const uint32_t *tokenHashes, size_t count, uint32_t *history, unsigned int &historySize, std::vector<uint32_t> &features) const
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		features.push_back(tokenHashes[i]);
+
+		// history holds the previous m_ngramOrder - 1 token hashes, most recent first
+		uint32_t ngram = tokenHashes[i];
+		for (unsigned int n = 0; n < historySize; ++n)
+		{
+			ngram = combineFeatureHash(history[n], ngram);
+			features.push_back(ngram);
+		}
+
+		if (m_ngramOrder > 1)
+		{
+			if (historySize < m_ngramOrder - 1)
+				++historySize;
+			for (unsigned int n = historySize - 1; n > 0; --n)
+				history[n] = history[n - 1];
+			history[0] = tokenHashes[i];
+		}
+	}
+}
+
+void HashedBayesClassifier::extractFeatures(const std::string &input, std::vector<uint32_t> &features) const
+{
+	TokenSpan tokens[TOKEN_BATCH];
+	uint32_t hashes[TOKEN_BATCH];
+	uint32_t history[MAX_NGRAM_ORDER];
+	unsigned int historySize = 0;
+	size_t batchSize = 0;
+
+	const char *cursor = input.data();
+	const char *end = cursor + input.size();
+	while (cursor < end)
+	{
+		while (cursor < end && isspace(static_cast<unsigned char>(*cursor)))
+			++cursor;
+		const char *tokenBegin = cursor;
+		while (cursor < end && !isspace(static_cast<unsigned char>(*cursor)))
+			++cursor;
+		if (cursor == tokenBegin)
+			break;
+
+		tokens[batchSize++] = {tokenBegin, static_cast<uint32_t>(cursor - tokenBegin)};
+		if (batchSize == TOKEN_BATCH)
+		{
+			hashTokenBatch(tokens, batchSize, hashes);
+			appendFeatures(hashes, batchSize, history, historySize, features);
+			batchSize = 0;
+		}
+	}
+
+	hashTokenBatch(tokens, batchSize, hashes);
+	appendFeatures(hashes, batchSize, history, historySize, features);
+}
+
+void HashedBayesClassifier::train(const std::string &sample, const std::string &response)
+{
+	std::vector<uint32_t> features;
+	extractFeatures(sample, features);
+	train(features.data(), features.size(), response);
+}
+
+void HashedBayesClassifier::predict(const std::string &input, std::string &output) const
+{
+	std::vector<uint32_t> features;
+	extractFeatures(input, features);
+	predict(features.data(), features.size(), output);
+}
+
+void HashedBayesClassifier::train(const uint32_t *features, size_t count, const std::string &response)
+{
+	const unsigned int r = responseIndex(response);
+	m_responses[r].count++;
+	m_responses[r].tokenCount += static_cast<unsigned int>(count);
+	m_sampleCount++;
+
+	for (size_t i = 0; i < count; ++i)
+		addFeature(features[i], r);
+}
+
+void HashedBayesClassifier::predict(const uint32_t *features, size_t count, std::string &output) const
+{
+	if (m_responses.empty())
+	{
+		output.clear();
+		return;
+	}
+
+	std::vector<float> scores;
+	std::vector<float> logDenominator;
+	beginScores(scores, logDenominator);
+
+	for (size_t i = 0; i < count; ++i)
+		scoreFeature(features[i], logDenominator, scores);
+
+	output = bestResponse(scores);
+}
+
+void HashedBayesClassifier::addFeature(uint32_t feature, unsigned int response)
+{
+	const uint32_t bucket = feature & m_bucketMask;
+	const size_t cell = static_cast<size_t>(bucket) * m_maxResponses + response;
+	m_logCounts[cell] = log(static_cast<float>(++m_counts[cell] + 1));
+
+	uint64_t &word = m_occupied[bucket / 64];
+	const uint64_t bit = 1ULL << (bucket % 64);
+	if (!(word & bit))
+	{
+		word |= bit;
+		m_occupiedCount++;
+	}
+}
+
+void HashedBayesClassifier::beginScores(std::vector<float> &scores, std::vector<float> &logDenominator) const
+{
+	// Laplace smoothing over the buckets seen so far
+	const size_t numResponses = m_responses.size();
+	scores.resize(numResponses);
+	logDenominator.resize(numResponses);
+	for (size_t r = 0; r < numResponses; ++r)
+	{
+		scores[r] = log(static_cast<float>(m_responses[r].count) / m_sampleCount);
+		logDenominator[r] = log(static_cast<float>(m_responses[r].tokenCount + m_occupiedCount));
+	}
+}
+
+void HashedBayesClassifier::scoreFeature(uint32_t feature, const std::vector<float> &logDenominator, std::vector<float> &scores) const
+{
+	// Empty buckets carry no evidence
+	const uint32_t bucket = feature & m_bucketMask;
+	if (!(m_occupied[bucket / 64] & (1ULL << (bucket % 64))))
+		return;
+
+	const float *row = &m_logCounts[static_cast<size_t>(bucket) * m_maxResponses];
+	for (size_t r = 0; r < scores.size(); ++r)
+		scores[r] += row[r] - logDenominator[r];
+}
+
+const std::string &HashedBayesClassifier::bestResponse(const std::vector<float> &scores) const
+{
+	size_t best = 0;
+	for (size_t r = 1; r < scores.size(); ++r)
+	{
+		if (scores[r] > scores[best])
+			best = r;
+	}
+
+	return m_responses[best].name;
+}
@@ -0,0 +1,116 @@
+// Bounded memory BayesClassifier using the hashing trick
+//
+// No vocabulary is stored: every token (and optionally every word n-gram up to
+// ngramOrder) is hashed into one of 2^bucketBits buckets, each holding a count
+// per response. Memory is fixed at construction time and a lookup is a single
+// row index. Colliding features share a bucket, which trades a little accuracy
+// for the bound; pick bucketBits so the table comfortably exceeds the active
+// vocabulary.
+//
+// Each bucket also keeps log(count + 1) per response, updated as it is trained,
+// so scoring a feature is a plain add per response with no log() call.
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "FeatureHash.h"
+
+namespace mhe
+{
+
+class HashedBayesClassifier
+{
+public:
+	HashedBayesClassifier(unsigned int bucketBits = 20, unsigned int maxResponses = 16, unsigned int ngramOrder = 1);
+	~HashedBayesClassifier() = default;
+
+	void train(const std::string &sample, const std::string &response);
+	void predict(const std::string &input, std::string &output) const;
+
+	// Train and predict on precomputed feature hashes
+	void train(const uint32_t *features, size_t count, const std::string &response);
+	void predict(const uint32_t *features, size_t count, std::string &output) const;
+
+	// Train and predict on features streamed from a FeaturePipeline, with no
+	// intermediate feature buffer
+	template <class Pipeline> void train(Pipeline &pipeline, const std::string &sample, const std::string &response);
+	template <class Pipeline> void predict(Pipeline &pipeline, const std::string &input, std::string &output) const;
+
+	// Whitespace tokenize and hash, appending unigram and n-gram features
+	void extractFeatures(const std::string &input, std::vector<uint32_t> &features) const;
+
+	unsigned int bucketCount() const { return m_bucketMask + 1; }
+	size_t memoryUsage() const;
+
+private:
+	unsigned int responseIndex(const std::string &response);
+	void addFeature(uint32_t feature, unsigned int response);
+	void beginScores(std::vector<float> &scores, std::vector<float> &logDenominator) const;
+	void scoreFeature(uint32_t feature, const std::vector<float> &logDenominator, std::vector<float> &scores) const;
+	const std::string &bestResponse(const std::vector<float> &scores) const;
+	void appendFeatures(const uint32_t *tokenHashes, size_t count, uint32_t *history, unsigned int &historySize, std::vector<uint32_t> &features) const;
+
+private:
+	struct ResponseData
+	{
+		std::string name;
+		unsigned int count;
+		unsigned int tokenCount;
+	};
+
+private:
+	unsigned int m_bucketMask;
+	unsigned int m_maxResponses;
+	unsigned int m_ngramOrder;
+
+	// [bucket][response], row stride m_maxResponses
+	std::vector<uint32_t> m_counts;
+	// log(count + 1) of the same cells
+	std::vector<float> m_logCounts;
+
+	// One bit per bucket that has been hit, the smoothing vocabulary size
+	std::vector<uint64_t> m_occupied;
+	unsigned int m_occupiedCount;
+
+	std::vector<ResponseData> m_responses;
+	unsigned int m_sampleCount;
+};
+
+
+/* Inline implementation */
+template <class Pipeline>
+inline void HashedBayesClassifier::train(Pipeline &pipeline, const std::string &sample, const std::string &response)
+{
+	const unsigned int r = responseIndex(response);
+	m_responses[r].count++;
+	m_sampleCount++;
+
+	pipeline.extract(sample, [this, r](uint32_t feature) {
+		m_responses[r].tokenCount++;
+		addFeature(feature, r);
+	});
+}
+
+template <class Pipeline>
+inline void HashedBayesClassifier::predict(Pipeline &pipeline, const std::string &input, std::string &output) const
+{
+	if (m_responses.empty())
+	{
+		output.clear();
+		return;
+	}
+
+	std::vector<float> scores;
+	std::vector<float> logDenominator;
+	beginScores(scores, logDenominator);
+
+	pipeline.extract(input, [&](uint32_t feature) {
+		scoreFeature(feature, logDenominator, scores);
+	});
+
+	output = bestResponse(scores);
+}
+
+} // mhe
@@ -0,0 +1,418 @@
+// Naive Bayes variants assembled from compile-time policies
+//
+//     NaiveBayes<Model, Smoothing, Weighting>
+//
+// Model      MultinomialModel, BernoulliModel or ComplementModel
+// Smoothing  LaplaceSmoothing or LidstoneSmoothing<numerator, denominator>
+// Weighting  TermFrequency, BinaryWeighting or TfIdfWeighting
+//
+// BernoulliModel counts documents, so it does not combine with TfIdfWeighting.
+//
+// Training accumulates per (token, response) weights. compute() folds the
+// chosen model, smoothing and weighting into one [token][response] table plus a
+// per-response bias, so every variant scores with the same loop. It must be
+// called after training and before predicting; predict() is then a pure read,
+// safe from any number of threads:
+//
+//     score[r] = bias[r] + sum over distinct tokens of queryWeight(tf) * table[token][r]
+//
+// All policy calls are static and inlined, so switching variants costs no
+// virtual call or branch per token.
+
+#pragma once
+
+#include <ctype.h>
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "FeatureHash.h"
+
+namespace mhe
+{
+
+/* Smoothing policies */
+template <unsigned int Numerator, unsigned int Denominator = 1>
+struct LidstoneSmoothing
+{
+	static constexpr float alpha = static_cast<float>(Numerator) / static_cast<float>(Denominator);
+
+	// log((count + alpha) / (total + alpha * outcomes))
+	static float logProbability(float count, float total, float outcomes)
+	{
+		return log((count + alpha) / (total + alpha * outcomes));
+	}
+};
+
+typedef LidstoneSmoothing<1> LaplaceSmoothing;
+
+/* Weighting policies: a document's weight for a token seen tf times */
+struct TermFrequency
+{
+	static const bool usesIdf = false;
+	static float weight(unsigned int tf) { return static_cast<float>(tf); }
+};
+
+struct BinaryWeighting
+{
+	static const bool usesIdf = false;
+	static float weight(unsigned int) { return 1.0f; }
+};
+
+// Sublinear tf, scaled by the smoothed idf of the token when the table is computed
+struct TfIdfWeighting
+{
+	static const bool usesIdf = true;
+	static float weight(unsigned int tf) { return log(1.0f + tf); }
+};
+
+/* Model policies
+ *
+ * trainWeight     what a document adds to table[token][response] during training
+ * queryWeight     what a query token multiplies its table row by
+ * compute         turns the accumulated weights into log table and bias
+ * countsDocuments weights must stay per response document counts (no idf)
+ */
+struct NaiveBayesCounts
+{
+	uint32_t numTokens;
+	uint32_t numResponses;
+
+	// [token][response], after any idf scaling
+	const std::vector<float> &weights;
+
+	// Per response: documents and summed weight
+	const std::vector<uint32_t> &documents;
+	const std::vector<float> &totals;
+	uint32_t totalDocuments;
+};
+
+struct MultinomialModel
+{
+	static const bool countsDocuments = false;
+
+	template <class Weighting> static float trainWeight(unsigned int tf) { return Weighting::weight(tf); }
+	template <class Weighting> static float queryWeight(unsigned int tf) { return Weighting::weight(tf); }
+
+	template <class Smoothing>
+	static void compute(const NaiveBayesCounts &counts, std::vector<float> &table, std::vector<float> &bias)
+	{
+		for (uint32_t r = 0; r < counts.numResponses; ++r)
+			bias[r] = log(static_cast<float>(counts.documents[r]) / counts.totalDocuments);
+
+		for (uint32_t t = 0; t < counts.numTokens; ++t)
+		{
+			for (uint32_t r = 0; r < counts.numResponses; ++r)
+			{
+				const size_t i = static_cast<size_t>(t) * counts.numResponses + r;
+				table[i] = Smoothing::logProbability(counts.weights[i], counts.totals[r], static_cast<float>(counts.numTokens));
+			}
+		}
+	}
+};
+
+// Models presence and absence of every vocabulary token; absent tokens are
+// folded into the bias so scoring still only visits the query's tokens
+struct BernoulliModel
+{
+	// documents[r] - weights[i] is the number of documents without the token
+	static const bool countsDocuments = true;
+
+	template <class Weighting> static float trainWeight(unsigned int) { return 1.0f; }
+	template <class Weighting> static float queryWeight(unsigned int) { return 1.0f; }
+
+	template <class Smoothing>
+	static void compute(const NaiveBayesCounts &counts, std::vector<float> &table, std::vector<float> &bias)
+	{
+		for (uint32_t r = 0; r < counts.numResponses; ++r)
+			bias[r] = log(static_cast<float>(counts.documents[r]) / counts.totalDocuments);
+
+		for (uint32_t t = 0; t < counts.numTokens; ++t)
+		{
+			for (uint32_t r = 0; r < counts.numResponses; ++r)
+			{
+				const size_t i = static_cast<size_t>(t) * counts.numResponses + r;
+				const float present = Smoothing::logProbability(counts.weights[i], static_cast<float>(counts.documents[r]), 2.0f);
+				const float absent = Smoothing::logProbability(counts.documents[r] - counts.weights[i], static_cast<float>(counts.documents[r]), 2.0f);
+				bias[r] += absent;
+				table[i] = present - absent;
+			}
+		}
+	}
+};
+
+// Rennie et al. 2003: estimate each response from every other response's
+// counts, which behaves much better on skewed training sets
+struct ComplementModel
+{
+	static const bool countsDocuments = false;
+
+	template <class Weighting> static float trainWeight(unsigned int tf) { return Weighting::weight(tf); }
+	template <class Weighting> static float queryWeight(unsigned int tf) { return Weighting::weight(tf); }
+
+	template <class Smoothing>
+	static void compute(const NaiveBayesCounts &counts, std::vector<float> &table, std::vector<float> &bias)
+	{
+		float grandTotal = 0.0f;
+		for (uint32_t r = 0; r < counts.numResponses; ++r)
+		{
+			grandTotal += counts.totals[r];
+			bias[r] = 0.0f;
+		}
+
+		for (uint32_t t = 0; t < counts.numTokens; ++t)
+		{
+			const float *row = &counts.weights[static_cast<size_t>(t) * counts.numResponses];
+			float rowTotal = 0.0f;
+			for (uint32_t r = 0; r < counts.numResponses; ++r)
+				rowTotal += row[r];
+
+			// Lower complement likelihood means a better match, hence the negation
+			for (uint32_t r = 0; r < counts.numResponses; ++r)
+			{
+				table[static_cast<size_t>(t) * counts.numResponses + r] = -Smoothing::logProbability(
+					rowTotal - row[r], grandTotal - counts.totals[r], static_cast<float>(counts.numTokens));
+			}
+		}
+	}
+};
+
+template <class Model, class Smoothing = LaplaceSmoothing, class Weighting = TermFrequency>
+class NaiveBayes
+{
+	static_assert(!(Model::countsDocuments && Weighting::usesIdf), "idf scaled weights are not document counts; BernoulliModel needs TermFrequency or BinaryWeighting");
+
+public:
+	NaiveBayes();
+	~NaiveBayes() = default;
+
+	void train(const std::string &sample, const std::string &response);
+	void predict(const std::string &input, std::string &output) const;
+
+	// Rebuild the scoring table after training; predict throws until it is current
+	void compute();
+	bool isComputed() const { return !m_dirty; }
+
+	uint32_t tokenCount() const { return static_cast<uint32_t>(m_vocabulary.size()); }
+	uint32_t responseCount() const { return static_cast<uint32_t>(m_responseList.size()); }
+
+private:
+	struct TermCount
+	{
+		uint32_t token;
+		unsigned int tf;
+	};
+
+	// Distinct tokens of the input with their frequency. lookup(token) returns
+	// the token id, or UINT32_MAX to skip the token
+	template <class Lookup> static void countTerms(const std::string &input, Lookup &&lookup, std::vector<TermCount> &terms);
+	uint32_t addToken(const std::string &token);
+
+private:
+	std::unordered_map<std::string, uint32_t> m_vocabulary;
+	std::vector<std::string> m_responseList;
+
+	// [token][response] accumulated training weights, raw (before idf)
+	std::vector<float> m_weights;
+	std::vector<uint32_t> m_documents;
+	std::vector<uint32_t> m_documentFrequency;
+	uint32_t m_totalDocuments;
+
+	// Scoring table, rebuilt by compute()
+	bool m_dirty;
+	std::vector<float> m_table;
+	std::vector<float> m_bias;
+};
+
+typedef NaiveBayes<MultinomialModel> MultinomialNaiveBayes;
+typedef NaiveBayes<BernoulliModel> BernoulliNaiveBayes;
+typedef NaiveBayes<ComplementModel> ComplementNaiveBayes;
+
+
+/* Inline implementation */
+template <class Model, class Smoothing, class Weighting>
+inline NaiveBayes<Model, Smoothing, Weighting>::NaiveBayes()
+	: m_totalDocuments(0)
+	, m_dirty(true)
+{
+}
+
+template <class Model, class Smoothing, class Weighting>
+inline uint32_t NaiveBayes<Model, Smoothing, Weighting>::addToken(const std::string &token)
+{
+	const auto found = m_vocabulary.find(token);
+	if (found != m_vocabulary.end())
+		return found->second;
+
+	const uint32_t id = static_cast<uint32_t>(m_vocabulary.size());
+	m_vocabulary.emplace(token, id);
+	m_weights.resize(m_weights.size() + m_responseList.size(), 0.0f);
+	m_documentFrequency.push_back(0);
+	return id;
+}
+
+template <class Model, class Smoothing, class Weighting>
+template <class Lookup>
+inline void NaiveBayes<Model, Smoothing, Weighting>::countTerms(const std::string &input, Lookup &&lookup, std::vector<TermCount> &terms)
+{
+	std::vector<uint32_t> ids;
+	std::string token;
+
+	const char *cursor = input.data();
+	const char *end = cursor + input.size();
+	while (cursor < end)
+	{
+		while (cursor < end && isspace(static_cast<unsigned char>(*cursor)))
+			++cursor;
+		token.clear();
+		while (cursor < end && !isspace(static_cast<unsigned char>(*cursor)))
+			token.push_back(static_cast<char>(asciiLower(static_cast<unsigned char>(*cursor++))));
+		if (token.empty())
+			break;
+
+		const uint32_t id = lookup(token);
+		if (id != UINT32_MAX)
+			ids.push_back(id);
+	}
+
+	// Run length over the sorted ids gives each distinct token and its tf
+	std::sort(ids.begin(), ids.end());
+	terms.clear();
+	for (size_t i = 0; i < ids.size(); ++i)
+	{
+		if (!terms.empty() && terms.back().token == ids[i])
+			terms.back().tf++;
+		else
+			terms.push_back({ids[i], 1});
+	}
+}
+
+template <class Model, class Smoothing, class Weighting>
+inline void NaiveBayes<Model, Smoothing, Weighting>::train(const std::string &sample, const std::string &response)
+{
+	uint32_t r = 0;
+	while (r < m_responseList.size() && m_responseList[r] != response)
+		++r;
+
+	if (r == m_responseList.size())
+	{
+		// Widen every token row by one response
+		const size_t oldResponses = m_responseList.size();
+		m_responseList.push_back(response);
+		m_documents.push_back(0);
+
+		std::vector<float> widened(m_vocabulary.size() * m_responseList.size(), 0.0f);
+		for (size_t t = 0; t < m_vocabulary.size(); ++t)
+		{
+			for (size_t old = 0; old < oldResponses; ++old)
+				widened[t * m_responseList.size() + old] = m_weights[t * oldResponses + old];
+		}
+		m_weights.swap(widened);
+	}
+
+	std::vector<TermCount> terms;
+	countTerms(sample, [this](const std::string &token) { return addToken(token); }, terms);
+
+	const size_t numResponses = m_responseList.size();
+	for (const TermCount &term : terms)
+	{
+		m_weights[term.token * numResponses + r] += Model::template trainWeight<Weighting>(term.tf);
+		m_documentFrequency[term.token]++;
+	}
+
+	m_documents[r]++;
+	m_totalDocuments++;
+	m_dirty = true;
+}
+
+template <class Model, class Smoothing, class Weighting>
+inline void NaiveBayes<Model, Smoothing, Weighting>::compute()
+{
+	const uint32_t numTokens = tokenCount();
+	const uint32_t numResponses = responseCount();
+
+	// Scale each token's row by its idf; other weightings use the raw weights
+	std::vector<float> scaled;
+	const std::vector<float> *weights = &m_weights;
+	if (Weighting::usesIdf)
+	{
+		scaled = m_weights;
+		for (uint32_t t = 0; t < numTokens; ++t)
+		{
+			const float idf = log((1.0f + m_totalDocuments) / (1.0f + m_documentFrequency[t])) + 1.0f;
+			for (uint32_t r = 0; r < numResponses; ++r)
+				scaled[static_cast<size_t>(t) * numResponses + r] *= idf;
+		}
+		weights = &scaled;
+	}
+
+	std::vector<float> totals(numResponses, 0.0f);
+	for (uint32_t t = 0; t < numTokens; ++t)
+	{
+		for (uint32_t r = 0; r < numResponses; ++r)
+			totals[r] += (*weights)[static_cast<size_t>(t) * numResponses + r];
+	}
+
+	const NaiveBayesCounts counts = {numTokens, numResponses, *weights, m_documents, totals, m_totalDocuments};
+	m_table.assign(static_cast<size_t>(numTokens) * numResponses, 0.0f);
+	m_bias.assign(numResponses, 0.0f);
+	Model::template compute<Smoothing>(counts, m_table, m_bias);
+
+	// The query side idf is folded into the table rows as well
+	if (Weighting::usesIdf)
+	{
+		for (uint32_t t = 0; t < numTokens; ++t)
+		{
+			const float idf = log((1.0f + m_totalDocuments) / (1.0f + m_documentFrequency[t])) + 1.0f;
+			for (uint32_t r = 0; r < numResponses; ++r)
+				m_table[static_cast<size_t>(t) * numResponses + r] *= idf;
+		}
+	}
+
+	m_dirty = false;
+}
+
+template <class Model, class Smoothing, class Weighting>
+inline void NaiveBayes<Model, Smoothing, Weighting>::predict(const std::string &input, std::string &output) const
+{
+	const uint32_t numResponses = responseCount();
+	if (numResponses == 0)
+	{
+		output.clear();
+		return;
+	}
+
+	// Computing here would write shared state from concurrent readers
+	if (m_dirty)
+		throw std::logic_error("NaiveBayes::predict called before compute() after training.");
+
+	// Unknown tokens carry no evidence
+	std::vector<TermCount> terms;
+	countTerms(input, [this](const std::string &token) {
+		const auto found = m_vocabulary.find(token);
+		return found != m_vocabulary.end() ? found->second : UINT32_MAX;
+	}, terms);
+
+	std::vector<float> scores(m_bias);
+	for (const TermCount &term : terms)
+	{
+		const float weight = Model::template queryWeight<Weighting>(term.tf);
+		const float *row = &m_table[static_cast<size_t>(term.token) * numResponses];
+		for (uint32_t r = 0; r < numResponses; ++r)
+			scores[r] += weight * row[r];
+	}
+
+	uint32_t best = 0;
+	for (uint32_t r = 1; r < numResponses; ++r)
+	{
+		if (scores[r] > scores[best])
+			best = r;
+	}
+
+	output = m_responseList[best];
+}
+
+} // mhe
@@ -0,0 +1,232 @@
+#include <ctype.h>
+#include <float.h>
+#include <math.h>
+#include <limits>
+#include "QuantizedBayesModel.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MHE_QUANTIZED_SSE2
+#endif
+
+using namespace mhe;
+
+namespace
+{
+	// |quantized value| <= 32768, so 32768 tokens sum to at most 2^30 in int32
+	const size_t FLUSH_TOKENS = 32768;
+}
+
+template <class Storage>
+QuantizedBayesModel<Storage>::QuantizedBayesModel(const BayesModel &source)
+	: m_source(source)
+	, m_numResponses(source.responseCount())
+	, m_stride((source.responseCount() + 15) & ~15u)
+	, m_fallbacks(0)
+{
+	const uint32_t numTokens = source.tokenCount();
+	const float levels = static_cast<float>(std::numeric_limits<Storage>::max()) - std::numeric_limits<Storage>::min();
+
+	// Per response range of log probabilities
+	m_scale.assign(m_numResponses, 1.0f);
+	m_offset.assign(m_numResponses, 0.0f);
+	m_magnitude.assign(m_numResponses, 0.0f);
+	for (uint32_t r = 0; r < m_numResponses; ++r)
+	{
+		float low = FLT_MAX;
+		float high = -FLT_MAX;
+		for (uint32_t t = 0; t < numTokens; ++t)
+		{
+			const float value = source.logProbabilities(t)[r];
+			low = value < low ? value : low;
+			high = value > high ? value : high;
+		}
+
+		if (numTokens == 0)
+			continue;
+
+		m_magnitude[r] = fabs(low) > fabs(high) ? fabs(low) : fabs(high);
+		m_scale[r] = high > low ? (high - low) / levels : 1.0f;
+		m_offset[r] = low - std::numeric_limits<Storage>::min() * m_scale[r];
+	}
+
+	m_table.assign(static_cast<size_t>(numTokens) * m_stride, 0);
+	for (uint32_t t = 0; t < numTokens; ++t)
+	{
+		const float *logProbs = source.logProbabilities(t);
+		for (uint32_t r = 0; r < m_numResponses; ++r)
+		{
+			float q = floor((logProbs[r] - m_offset[r]) / m_scale[r] + 0.5f);
+			q = q < std::numeric_limits<Storage>::min() ? std::numeric_limits<Storage>::min() : q;
+			q = q > std::numeric_limits<Storage>::max() ? std::numeric_limits<Storage>::max() : q;
+			m_table[static_cast<size_t>(t) * m_stride + r] = static_cast<Storage>(q);
+		}
+	}
+}
+
+template <class Storage>
+float QuantizedBayesModel<Storage>::dequantize(uint32_t token, uint32_t response) const
+{
+	return m_offset[response] + m_scale[response] * m_table[static_cast<size_t>(token) * m_stride + response];
+}
+
+template <class Storage>
+double QuantizedBayesModel<Storage>::scoreErrorBound(uint32_t response, uint32_t tokenCount) const
+{
+	// Half a step of rounding per token, plus slack for computing the steps
+	const double tokens = tokenCount;
+	const double rounding = tokens * (0.5 * m_scale[response] + 1e-5);
+
+	// BayesModel sums prior + token 1 + ... + token n in float; each add rounds by
+	// at most FLT_EPSILON / 2 of its partial score, and partial score k is at most
+	// |prior| + k * magnitude. FLT_EPSILON rather than half of it leaves room for
+	// the higher order terms and the rounding of the quantized score itself.
+	const double partialSums = tokens * fabs(m_source.response(response).logPrior) + tokens * (tokens + 1) / 2 * m_magnitude[response];
+	return rounding + FLT_EPSILON * partialSums;
+}
+
+template <class Storage>
+void QuantizedBayesModel<Storage>::accumulatePair(uint32_t tokenA, uint32_t tokenB, int16_t weightB, int32_t *scores) const
+{
+	const Storage *rowA = &m_table[static_cast<size_t>(tokenA) * m_stride];
+	const Storage *rowB = &m_table[static_cast<size_t>(tokenB) * m_stride];
+	uint32_t r = 0;
+
+#ifdef MHE_QUANTIZED_SSE2
+	// Interleave the two rows so pmaddwd computes a[r] * 1 + b[r] * weightB per lane
+	const __m128i weights = _mm_set_epi16(weightB, 1, weightB, 1, weightB, 1, weightB, 1);
+	for (; r < m_stride; r += 16)
+	{
+		__m128i a0, a1, b0, b1;
+		if (sizeof(Storage) == 2)
+		{
+			a0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rowA + r));
+			a1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rowA + r + 8));
+			b0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rowB + r));
+			b1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rowB + r + 8));
+		}
+		else
+		{
+			// Sign extend 16 int8 values into two registers of int16
+			const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rowA + r));
+			const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rowB + r));
+			const __m128i signA = _mm_cmpgt_epi8(_mm_setzero_si128(), a);
+			const __m128i signB = _mm_cmpgt_epi8(_mm_setzero_si128(), b);
+			a0 = _mm_unpacklo_epi8(a, signA);
+			a1 = _mm_unpackhi_epi8(a, signA);
+			b0 = _mm_unpacklo_epi8(b, signB);
+			b1 = _mm_unpackhi_epi8(b, signB);
+		}
+
+		__m128i *out = reinterpret_cast<__m128i *>(scores + r);
+		_mm_storeu_si128(out + 0, _mm_add_epi32(_mm_loadu_si128(out + 0), _mm_madd_epi16(_mm_unpacklo_epi16(a0, b0), weights)));
+		_mm_storeu_si128(out + 1, _mm_add_epi32(_mm_loadu_si128(out + 1), _mm_madd_epi16(_mm_unpackhi_epi16(a0, b0), weights)));
+		_mm_storeu_si128(out + 2, _mm_add_epi32(_mm_loadu_si128(out + 2), _mm_madd_epi16(_mm_unpacklo_epi16(a1, b1), weights)));
+		_mm_storeu_si128(out + 3, _mm_add_epi32(_mm_loadu_si128(out + 3), _mm_madd_epi16(_mm_unpackhi_epi16(a1, b1), weights)));
+	}
+#endif
+
+	for (; r < m_stride; ++r)
+		scores[r] += rowA[r] + rowB[r] * weightB;
+}
+
+template <class Storage>
+void QuantizedBayesModel<Storage>::predict(const std::string &input, std::string &output, bool exact) const
+{
+	if (m_numResponses == 0)
+	{
+		output.clear();
+		return;
+	}
+
+	std::vector<uint32_t> tokens;
+	const char *cursor = input.data();
+	const char *end = cursor + input.size();
+	while (cursor < end)
+	{
+		while (cursor < end && isspace(static_cast<unsigned char>(*cursor)))
+			++cursor;
+		const char *tokenBegin = cursor;
+		while (cursor < end && !isspace(static_cast<unsigned char>(*cursor)))
+			++cursor;
+		if (cursor == tokenBegin)
+			break;
+
+		const uint32_t token = m_source.findToken(tokenBegin, cursor - tokenBegin);
+		if (token != BAYES_MODEL_EMPTY_SLOT)
+			tokens.push_back(token);
+	}
+
+	// Two tokens per pass; an odd last token is paired with itself at weight 0.
+	// The int32 lanes are flushed into int64 totals before they could overflow.
+	std::vector<int32_t> quantized(m_stride, 0);
+	std::vector<int64_t> totals(m_numResponses, 0);
+	for (size_t block = 0; block < tokens.size(); block += FLUSH_TOKENS)
+	{
+		const size_t blockEnd = tokens.size() - block < FLUSH_TOKENS ? tokens.size() : block + FLUSH_TOKENS;
+		for (size_t i = block; i < blockEnd; i += 2)
+		{
+			if (i + 1 < blockEnd)
+				accumulatePair(tokens[i], tokens[i + 1], 1, quantized.data());
+			else
+				accumulatePair(tokens[i], tokens[i], 0, quantized.data());
+		}
+
+		for (uint32_t r = 0; r < m_numResponses; ++r)
+		{
+			totals[r] += quantized[r];
+			quantized[r] = 0;
+		}
+	}
+
+	// In double so the quantized scores add no rounding of their own worth counting
+	const uint32_t numTokens = static_cast<uint32_t>(tokens.size());
+	std::vector<double> scores(m_numResponses);
+	uint32_t best = 0;
+	for (uint32_t r = 0; r < m_numResponses; ++r)
+	{
+		scores[r] = m_source.response(r).logPrior + static_cast<double>(m_offset[r]) * numTokens + static_cast<double>(m_scale[r]) * totals[r];
+		if (scores[r] > scores[best])
+			best = r;
+	}
+
+	if (exact)
+	{
+		// Any response whose interval overlaps the winner's could be the float argmax
+		const double bestLow = scores[best] - scoreErrorBound(best, numTokens);
+		std::vector<uint32_t> candidates;
+		for (uint32_t r = 0; r < m_numResponses; ++r)
+		{
+			if (r != best && scores[r] + scoreErrorBound(r, numTokens) >= bestLow)
+				candidates.push_back(r);
+		}
+
+		if (!candidates.empty())
+		{
+			m_fallbacks.fetch_add(1, std::memory_order_relaxed);
+			candidates.push_back(best);
+
+			float bestExact = -FLT_MAX;
+			for (uint32_t r : candidates)
+			{
+				// Same summation order as BayesModel::predict
+				float score = m_source.response(r).logPrior;
+				for (uint32_t token : tokens)
+					score += m_source.logProbabilities(token)[r];
+				if (score > bestExact || (score == bestExact && r < best))
+				{
+					bestExact = score;
+					best = r;
+				}
+			}
+		}
+	}
+
+	output = m_source.responseName(best);
+}
+
+namespace mhe
+{
+	template class QuantizedBayesModel<int16_t>;
+	template class QuantizedBayesModel<int8_t>;
+}
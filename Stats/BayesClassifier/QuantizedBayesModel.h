@@ -0,0 +1,76 @@
+// Integer quantized scoring table for a frozen BayesModel
+//
+// Each response's log probabilities are mapped linearly onto int16_t or int8_t
+// (per response scale and offset), which makes the [token][response] table 2x
+// or 4x smaller than float and keeps it cache resident. Scores accumulate in
+// int32, two query tokens at a time with pmaddwd, and are flushed to int64 every
+// 32768 tokens so long documents cannot overflow:
+//
+//     score[r] = prior[r] + offset[r] * tokens + scale[r] * sum(q[t][r])
+//
+// Rounding bounds the per token error by scale[r] / 2. The float model's own
+// sequential summation drifts too, by up to about FLT_EPSILON times the sum of
+// its partial scores, so scoreErrorBound() adds both: it tells how far a
+// quantized score can be from the score BayesModel::predict computes. When the
+// best responses are closer than that, predict rescores them with the float
+// table of the source model in the same order, so the argmax always matches
+// BayesModel::predict.
+//
+// The source model stays the vocabulary and must outlive the quantized one.
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include "BayesModel.h"
+
+namespace mhe
+{
+
+template <class Storage>
+class QuantizedBayesModel
+{
+	static_assert(sizeof(Storage) <= 2, "QuantizedBayesModel stores int16_t or int8_t");
+
+public:
+	explicit QuantizedBayesModel(const BayesModel &source);
+	~QuantizedBayesModel() = default;
+
+	// exact: rescore near ties with the float table so the argmax matches it
+	void predict(const std::string &input, std::string &output, bool exact = true) const;
+
+	// Largest difference between a quantized score and BayesModel's float score
+	// over tokenCount tokens
+	double scoreErrorBound(uint32_t response, uint32_t tokenCount) const;
+
+	float dequantize(uint32_t token, uint32_t response) const;
+	size_t tableBytes() const { return m_table.size() * sizeof(Storage); }
+
+	// Number of predictions that fell back to the float table
+	uint64_t fallbackCount() const { return m_fallbacks.load(std::memory_order_relaxed); }
+
+private:
+	void accumulatePair(uint32_t tokenA, uint32_t tokenB, int16_t weightB, int32_t *scores) const;
+
+private:
+	const BayesModel &m_source;
+	uint32_t m_numResponses;
+
+	// Rows padded to a multiple of 16 responses for the SIMD loop
+	uint32_t m_stride;
+	std::vector<Storage> m_table;
+	std::vector<float> m_scale;
+	std::vector<float> m_offset;
+	// Largest |log probability| per response, for the float summation error
+	std::vector<float> m_magnitude;
+
+	// Statistics only, bumped from concurrent predict calls
+	mutable std::atomic<uint64_t> m_fallbacks;
+};
+
+typedef QuantizedBayesModel<int16_t> QuantizedBayesModel16;
+typedef QuantizedBayesModel<int8_t> QuantizedBayesModel8;
+
+} // mhe
@@ -0,0 +1,290 @@
+#include <ctype.h>
+#include <math.h>
+#include <string.h>
+#include "SparseBayesModel.h"
+
+using namespace mhe;
+
+namespace
+{
+	void writeVarint(std::vector<uint8_t> &out, uint32_t value)
+	{
+		while (value >= 0x80)
+		{
+			out.push_back(static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back(static_cast<uint8_t>(value));
+	}
+
+	uint32_t readVarint(const uint8_t *&cursor)
+	{
+		uint32_t value = 0;
+		unsigned int shift = 0;
+		while (*cursor & 0x80)
+		{
+			value |= static_cast<uint32_t>(*cursor++ & 0x7F) << shift;
+			shift += 7;
+		}
+		value |= static_cast<uint32_t>(*cursor++) << shift;
+		return value;
+	}
+
+	size_t varintSize(uint32_t value)
+	{
+		size_t size = 1;
+		while (value >= 0x80)
+		{
+			value >>= 7;
+			++size;
+		}
+		return size;
+	}
+}
+
+void SparseBayesModel::build(const BayesModel &model)
+{
+	const uint32_t numTokens = model.tokenCount();
+	const uint32_t numResponses = model.responseCount();
+
+	m_responseNames.clear();
+	m_logPriors.clear();
+	m_logDefaults.clear();
+	for (uint32_t r = 0; r < numResponses; ++r)
+	{
+		m_responseNames.push_back(model.responseName(r));
+		m_logPriors.push_back(model.response(r).logPrior);
+		m_logDefaults.push_back(0.0f);
+	}
+
+	// The default of a response is the log probability of any unobserved token
+	for (uint32_t r = 0; r < numResponses; ++r)
+	{
+		for (uint32_t t = 0; t < numTokens; ++t)
+		{
+			if (model.count(t, r) == 0)
+			{
+				m_logDefaults[r] = model.logProbabilities(t)[r];
+				break;
+			}
+		}
+	}
+
+	m_tokenRows.assign(numTokens, 0);
+	m_sparseData.clear();
+	m_denseCounts.clear();
+	m_denseValues.clear();
+	m_denseRows = 0;
+
+	const size_t denseBytes = numResponses * (sizeof(uint32_t) + sizeof(float));
+	for (uint32_t t = 0; t < numTokens; ++t)
+	{
+		const float *logProbs = model.logProbabilities(t);
+
+		size_t entries = 0;
+		size_t sparseBytes = 0;
+		uint32_t previous = 0;
+		for (uint32_t r = 0; r < numResponses; ++r)
+		{
+			const uint32_t count = model.count(t, r);
+			if (count == 0)
+				continue;
+			++entries;
+			sparseBytes += varintSize(r - previous) + varintSize(count) + sizeof(float);
+			previous = r;
+		}
+		sparseBytes += varintSize(static_cast<uint32_t>(entries));
+
+		if (sparseBytes >= denseBytes)
+		{
+			m_tokenRows[t] = DENSE_ROW | m_denseRows++;
+			for (uint32_t r = 0; r < numResponses; ++r)
+			{
+				m_denseCounts.push_back(model.count(t, r));
+				m_denseValues.push_back(logProbs[r] - m_logDefaults[r]);
+			}
+			continue;
+		}
+
+		m_tokenRows[t] = static_cast<uint32_t>(m_sparseData.size());
+		writeVarint(m_sparseData, static_cast<uint32_t>(entries));
+		previous = 0;
+		for (uint32_t r = 0; r < numResponses; ++r)
+		{
+			const uint32_t count = model.count(t, r);
+			if (count == 0)
+				continue;
+
+			const float value = logProbs[r] - m_logDefaults[r];
+			uint8_t valueBytes[sizeof(float)];
+			memcpy(valueBytes, &value, sizeof(float));
+
+			writeVarint(m_sparseData, r - previous);
+			writeVarint(m_sparseData, count);
+			m_sparseData.insert(m_sparseData.end(), valueBytes, valueBytes + sizeof(float));
+			previous = r;
+		}
+	}
+
+	// Copy the vocabulary into a compact index of our own
+	uint32_t hashCapacity = 16;
+	while (hashCapacity < static_cast<uint64_t>(numTokens) * 2 && hashCapacity < 0x80000000u)
+		hashCapacity <<= 1;
+
+	m_stringOffsets.assign(1, 0);
+	m_stringData.clear();
+	m_slots.assign(hashCapacity, BayesModelSlot{0, BAYES_MODEL_EMPTY_SLOT, 0});
+	for (uint32_t t = 0; t < numTokens; ++t)
+	{
+		uint32_t length;
+		const char *token = model.tokenName(t, length);
+		m_stringData.insert(m_stringData.end(), token, token + length);
+		m_stringOffsets.push_back(static_cast<uint32_t>(m_stringData.size()));
+
+		const uint64_t hash = hashToken(token, length);
+		uint32_t slot = static_cast<uint32_t>(hash) & (hashCapacity - 1);
+		while (m_slots[slot].token != BAYES_MODEL_EMPTY_SLOT)
+			slot = (slot + 1) & (hashCapacity - 1);
+		m_slots[slot].hash = hash;
+		m_slots[slot].token = t;
+	}
+}
+
+size_t SparseBayesModel::memoryUsage() const
+{
+	size_t bytes = m_stringOffsets.size() * sizeof(uint32_t)
+		+ m_stringData.size()
+		+ m_slots.size() * sizeof(BayesModelSlot)
+		+ m_tokenRows.size() * sizeof(uint32_t)
+		+ m_sparseData.size()
+		+ m_denseCounts.size() * sizeof(uint32_t)
+		+ m_denseValues.size() * sizeof(float)
+		+ (m_logPriors.size() + m_logDefaults.size()) * sizeof(float);
+	for (const auto &name : m_responseNames)
+		bytes += name.size();
+	return bytes;
+}
+
+uint32_t SparseBayesModel::findToken(const char *token, size_t length) const
+{
+	if (m_slots.empty())
+		return BAYES_MODEL_EMPTY_SLOT;
+
+	const uint64_t hash = hashToken(token, length);
+	const uint32_t mask = static_cast<uint32_t>(m_slots.size()) - 1;
+
+	for (uint32_t slot = static_cast<uint32_t>(hash) & mask; ; slot = (slot + 1) & mask)
+	{
+		const BayesModelSlot &entry = m_slots[slot];
+		if (entry.token == BAYES_MODEL_EMPTY_SLOT)
+			return BAYES_MODEL_EMPTY_SLOT;
+		if (entry.hash != hash)
+			continue;
+
+		const uint32_t begin = m_stringOffsets[entry.token];
+		if (m_stringOffsets[entry.token + 1] - begin != length)
+			continue;
+
+		size_t i = 0;
+		while (i < length && m_stringData[begin + i] == tolower(static_cast<unsigned char>(token[i])))
+			++i;
+		if (i == length)
+			return entry.token;
+	}
+}
+
+template <class Visitor>
+inline void SparseBayesModel::visitRow(uint32_t token, Visitor &&visitor) const
+{
+	// visitor(response, count, difference) for every observed response of the token
+	const uint32_t row = m_tokenRows[token];
+	const uint32_t numResponses = responseCount();
+
+	if (row & DENSE_ROW)
+	{
+		const size_t base = static_cast<size_t>(row & ~DENSE_ROW) * numResponses;
+		for (uint32_t r = 0; r < numResponses; ++r)
+			visitor(r, m_denseCounts[base + r], m_denseValues[base + r]);
+		return;
+	}
+
+	const uint8_t *cursor = m_sparseData.data() + row;
+	const uint32_t entries = readVarint(cursor);
+	uint32_t response = 0;
+	for (uint32_t e = 0; e < entries; ++e)
+	{
+		response += readVarint(cursor);
+		const uint32_t count = readVarint(cursor);
+		float value;
+		memcpy(&value, cursor, sizeof(float));
+		cursor += sizeof(float);
+		visitor(response, count, value);
+	}
+}
+
+uint32_t SparseBayesModel::count(uint32_t token, uint32_t response) const
+{
+	uint32_t result = 0;
+	visitRow(token, [&](uint32_t r, uint32_t count, float) {
+		if (r == response)
+			result = count;
+	});
+	return result;
+}
+
+float SparseBayesModel::logProbability(uint32_t token, uint32_t response) const
+{
+	float result = m_logDefaults[response];
+	visitRow(token, [&](uint32_t r, uint32_t, float value) {
+		if (r == response)
+			result += value;
+	});
+	return result;
+}
+
+void SparseBayesModel::predict(const std::string &input, std::string &output) const
+{
+	const uint32_t numResponses = responseCount();
+	if (numResponses == 0)
+	{
+		output.clear();
+		return;
+	}
+
+	std::vector<float> scores(m_logPriors);
+	unsigned int knownTokens = 0;
+
+	const char *cursor = input.data();
+	const char *end = cursor + input.size();
+	while (cursor < end)
+	{
+		while (cursor < end && isspace(static_cast<unsigned char>(*cursor)))
+			++cursor;
+		const char *tokenBegin = cursor;
+		while (cursor < end && !isspace(static_cast<unsigned char>(*cursor)))
+			++cursor;
+		if (cursor == tokenBegin)
+			break;
+
+		const uint32_t token = findToken(tokenBegin, cursor - tokenBegin);
+		if (token == BAYES_MODEL_EMPTY_SLOT)
+			continue;
+
+		// Only observed responses are touched; the defaults are added once below,
+		// which rounds differently from adding them token by token
+		++knownTokens;
+		visitRow(token, [&](uint32_t r, uint32_t, float value) {
+			scores[r] += value;
+		});
+	}
+
+	uint32_t best = 0;
+	for (uint32_t r = 0; r < numResponses; ++r)
+	{
+		scores[r] += knownTokens * m_logDefaults[r];
+		if (scores[r] > scores[best])
+			best = r;
+	}
+
+	output = m_responseNames[best];
+}
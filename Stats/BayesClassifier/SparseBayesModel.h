@@ -0,0 +1,73 @@
+// Frozen BayesClassifier tables in a sparse, per-token compressed layout
+//
+// Most (token, response) pairs are never observed, and every unobserved pair of
+// a response shares the same smoothed log probability. The model therefore
+// stores that per-response default once and, per token, only the difference
+// (log probability - default) for the observed responses:
+//
+//   sparse token  varint entry count, then per entry
+//                 varint response delta, varint count, float difference
+//   dense token   a full row of counts and differences, used when the token is
+//                 observed in so many responses that a row is smaller
+//
+// Scoring adds the defaults once per known token and gathers the sparse rows.
+// That is the dense model's sum regrouped, so the scores equal BayesModel's only
+// up to float rounding: when two responses score within rounding of each other
+// the two models can pick different ones.
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "BayesModel.h"
+
+namespace mhe
+{
+
+class SparseBayesModel
+{
+public:
+	SparseBayesModel() = default;
+	~SparseBayesModel() = default;
+
+	// Re-encode a mapped or in-memory dense model
+	void build(const BayesModel &model);
+
+	void predict(const std::string &input, std::string &output) const;
+
+	// Token id, or BAYES_MODEL_EMPTY_SLOT if the token is unknown
+	uint32_t findToken(const char *token, size_t length) const;
+
+	uint32_t count(uint32_t token, uint32_t response) const;
+	float logProbability(uint32_t token, uint32_t response) const;
+
+	uint32_t tokenCount() const { return static_cast<uint32_t>(m_tokenRows.size()); }
+	uint32_t responseCount() const { return static_cast<uint32_t>(m_responseNames.size()); }
+	uint32_t denseTokenCount() const { return m_denseRows; }
+	size_t memoryUsage() const;
+
+private:
+	// Top bit marks a dense row; the rest is a row index or a byte offset
+	static const uint32_t DENSE_ROW = 0x80000000u;
+
+	template <class Visitor> void visitRow(uint32_t token, Visitor &&visitor) const;
+
+private:
+	std::vector<std::string> m_responseNames;
+	std::vector<float> m_logPriors;
+	std::vector<float> m_logDefaults;
+
+	// Token index, same probing scheme as the binary format
+	std::vector<uint32_t> m_stringOffsets;
+	std::vector<char> m_stringData;
+	std::vector<BayesModelSlot> m_slots;
+
+	std::vector<uint32_t> m_tokenRows;
+	std::vector<uint8_t> m_sparseData;
+	std::vector<uint32_t> m_denseCounts;
+	std::vector<float> m_denseValues;
+	uint32_t m_denseRows = 0;
+};
+
+} // mhe
@@ -0,0 +1,493 @@
+#include <algorithm>
+#include <condition_variable>
+#include <float.h>
+#include <math.h>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include "KMeans.h"
+
+using namespace mhe;
+
+namespace mhe
+{
+
+// Threads kept for one run(); parallelFor hands every pass to the same workers
+// instead of starting and joining threads per pass
+class KMeansWorkers
+{
+public:
+	explicit KMeansWorkers(unsigned int threads)
+		: m_threadCount(threads)
+		, m_generation(0)
+		, m_pending(0)
+		, m_stop(false)
+		, m_count(0)
+		, m_chunk(0)
+		, m_invoke(nullptr)
+		, m_fn(nullptr)
+	{
+		for (unsigned int t = 1; t < threads; ++t)
+			m_threads.emplace_back([this, t]() { workerLoop(t); });
+	}
+
+	~KMeansWorkers()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_wake.notify_all();
+		for (auto &thread : m_threads)
+			thread.join();
+	}
+
+	KMeansWorkers(const KMeansWorkers &) = delete;
+	KMeansWorkers &operator=(const KMeansWorkers &) = delete;
+
+	unsigned int threadCount() const { return m_threadCount; }
+
+	// Run fn(begin, end, thread) over [0, count) split into one chunk per thread
+	template <class Fn>
+	void parallelFor(size_t count, Fn &&fn)
+	{
+		if (m_threads.empty() || count < m_threadCount * 1024)
+		{
+			fn(static_cast<size_t>(0), count, 0u);
+			return;
+		}
+
+		const size_t chunk = (count + m_threadCount - 1) / m_threadCount;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_count = count;
+			m_chunk = chunk;
+			m_invoke = &invoke<typename std::remove_reference<Fn>::type>;
+			m_fn = &fn;
+			m_pending = m_threadCount - 1;
+			m_generation++;
+		}
+		m_wake.notify_all();
+
+		fn(static_cast<size_t>(0), std::min(count, chunk), 0u);
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done.wait(lock, [this]() { return m_pending == 0; });
+	}
+
+private:
+	template <class Fn>
+	static void invoke(void *fn, size_t begin, size_t end, unsigned int thread)
+	{
+		(*static_cast<Fn *>(fn))(begin, end, thread);
+	}
+
+	void workerLoop(unsigned int t)
+	{
+		uint64_t seen = 0;
+		std::unique_lock<std::mutex> lock(m_mutex);
+		for (;;)
+		{
+			m_wake.wait(lock, [this, seen]() { return m_stop || m_generation != seen; });
+			if (m_stop)
+				return;
+			seen = m_generation;
+
+			const size_t begin = std::min(m_count, t * m_chunk);
+			const size_t end = std::min(m_count, begin + m_chunk);
+			void (*invoke)(void *, size_t, size_t, unsigned int) = m_invoke;
+			void *fn = m_fn;
+
+			lock.unlock();
+			invoke(fn, begin, end, t);
+			lock.lock();
+
+			if (--m_pending == 0)
+				m_done.notify_one();
+		}
+	}
+
+private:
+	unsigned int m_threadCount;
+	std::vector<std::thread> m_threads;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	uint64_t m_generation;
+	unsigned int m_pending;
+	bool m_stop;
+
+	// Current pass, valid while m_pending > 0
+	size_t m_count;
+	size_t m_chunk;
+	void (*m_invoke)(void *, size_t, size_t, unsigned int);
+	void *m_fn;
+};
+
+} // mhe
+
+namespace
+{
+	// splitmix64, enough randomness for seeding
+	uint64_t nextRandom(uint64_t &state)
+	{
+		uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		return z ^ (z >> 31);
+	}
+
+	double nextUniform(uint64_t &state)
+	{
+		return (nextRandom(state) >> 11) * (1.0 / 9007199254740992.0);
+	}
+
+	float squaredDistance(const PointSetSoA &a, size_t i, const PointSetSoA &b, size_t j)
+	{
+		float sum = 0.0f;
+		for (unsigned int d = 0; d < a.dims; ++d)
+		{
+			const float delta = a.coords[d][i] - b.coords[d][j];
+			sum += delta * delta;
+		}
+		return sum;
+	}
+
+	// Squared distance from point i to every centroid, written to out[k]
+	void distancesToAll(const PointSetSoA &points, size_t i, const PointSetSoA &centroids, float *out)
+	{
+		const size_t k = centroids.size();
+		const float x = points.coords[0][i];
+		const float *cx = centroids.coords[0].data();
+		for (size_t j = 0; j < k; ++j)
+			out[j] = (cx[j] - x) * (cx[j] - x);
+
+		for (unsigned int d = 1; d < points.dims; ++d)
+		{
+			const float v = points.coords[d][i];
+			const float *c = centroids.coords[d].data();
+			for (size_t j = 0; j < k; ++j)
+				out[j] += (c[j] - v) * (c[j] - v);
+		}
+	}
+
+	struct ThreadAccumulator
+	{
+		std::vector<double> sums; // [dim][cluster]
+		std::vector<uint32_t> counts;
+		std::vector<float> distances;
+		uint64_t scans = 0;
+		bool changed = false;
+	};
+}
+
+void PointSetSoA::resize(size_t count)
+{
+	for (unsigned int d = 0; d < dims; ++d)
+		coords[d].resize(count);
+}
+
+PointSetSoA PointSetSoA::fromPoints(const std::vector<Vec2f> &points)
+{
+	PointSetSoA set;
+	set.dims = 2;
+	set.resize(points.size());
+	for (size_t i = 0; i < points.size(); ++i)
+	{
+		set.coords[0][i] = points[i].x();
+		set.coords[1][i] = points[i].y();
+	}
+	return set;
+}
+
+PointSetSoA PointSetSoA::fromPoints(const std::vector<Vec3f> &points)
+{
+	PointSetSoA set;
+	set.dims = 3;
+	set.resize(points.size());
+	for (size_t i = 0; i < points.size(); ++i)
+	{
+		set.coords[0][i] = points[i].x();
+		set.coords[1][i] = points[i].y();
+		set.coords[2][i] = points[i].z();
+	}
+	return set;
+}
+
+KMeans::KMeans(const KMeansOptions &options)
+	: m_options(options)
+{
+}
+
+unsigned int KMeans::threadCount() const
+{
+	if (m_options.threads > 0)
+		return m_options.threads;
+
+	const unsigned int hardware = std::thread::hardware_concurrency();
+	return hardware > 0 ? hardware : 1;
+}
+
+void KMeans::seed(const PointSetSoA &points, PointSetSoA &centroids, KMeansWorkers &workers) const
+{
+	const size_t n = points.size();
+	const unsigned int k = static_cast<unsigned int>(centroids.size());
+	const unsigned int threads = workers.threadCount();
+	uint64_t random = m_options.seed;
+
+	auto copyCentroid = [&](unsigned int c, size_t i) {
+		for (unsigned int d = 0; d < points.dims; ++d)
+			centroids.coords[d][c] = points.coords[d][i];
+	};
+
+	copyCentroid(0, static_cast<size_t>(nextRandom(random) % n));
+
+	// k-means++: next centroid drawn with probability proportional to D(x)^2
+	std::vector<float> minDistance(n, FLT_MAX);
+	std::vector<double> chunkSums(threads);
+	std::vector<size_t> chunkBegin(threads, n);
+	std::vector<size_t> chunkEnd(threads, n);
+
+	for (unsigned int c = 1; c < k; ++c)
+	{
+		std::fill(chunkSums.begin(), chunkSums.end(), 0.0);
+		workers.parallelFor(n, [&](size_t begin, size_t end, unsigned int t) {
+			double sum = 0.0;
+			for (size_t i = begin; i < end; ++i)
+			{
+				const float distance = squaredDistance(points, i, centroids, c - 1);
+				if (distance < minDistance[i])
+					minDistance[i] = distance;
+				sum += minDistance[i];
+			}
+			chunkSums[t] = sum;
+			chunkBegin[t] = begin;
+			chunkEnd[t] = end;
+		});
+
+		double total = 0.0;
+		for (double sum : chunkSums)
+			total += sum;
+
+		// Every point sits on a centroid already; any choice is as good
+		if (total <= 0.0)
+		{
+			copyCentroid(c, static_cast<size_t>(nextRandom(random) % n));
+			continue;
+		}
+
+		double target = nextUniform(random) * total;
+		size_t chosen = n - 1;
+		for (unsigned int t = 0; t < threads; ++t)
+		{
+			if (chunkBegin[t] >= n)
+				continue;
+			if (target >= chunkSums[t])
+			{
+				target -= chunkSums[t];
+				continue;
+			}
+
+			for (size_t i = chunkBegin[t]; i < chunkEnd[t]; ++i)
+			{
+				target -= minDistance[i];
+				if (target < 0.0)
+				{
+					chosen = i;
+					break;
+				}
+			}
+			break;
+		}
+
+		copyCentroid(c, chosen);
+	}
+}
+
+KMeansResult KMeans::run(const PointSetSoA &points) const
+{
+	KMeansResult result;
+	const size_t n = points.size();
+	const unsigned int k = static_cast<unsigned int>(std::min<size_t>(m_options.k, n));
+	const unsigned int dims = points.dims;
+	const unsigned int threads = threadCount();
+
+	result.centroids.dims = dims;
+	result.centroids.resize(k);
+	if (k == 0)
+		return result;
+
+	KMeansWorkers workers(threads);
+	seed(points, result.centroids, workers);
+	PointSetSoA &centroids = result.centroids;
+
+	// Hamerly bounds: upper >= distance to own centroid, lower <= distance to any other
+	std::vector<uint32_t> &assignment = result.assignments;
+	assignment.assign(n, 0);
+	std::vector<float> upper(n, FLT_MAX);
+	std::vector<float> lower(n, 0.0f);
+
+	std::vector<ThreadAccumulator> accumulators(threads);
+	for (auto &accumulator : accumulators)
+	{
+		accumulator.sums.resize(static_cast<size_t>(dims) * k);
+		accumulator.counts.resize(k);
+		accumulator.distances.resize(k);
+	}
+
+	std::vector<float> halfSeparation(k, FLT_MAX);
+	std::vector<float> movement(k, 0.0f);
+	PointSetSoA previous;
+	previous.dims = dims;
+
+	for (unsigned int iteration = 0; iteration < m_options.maxIterations; ++iteration)
+	{
+		result.iterations = iteration + 1;
+
+		// Half the distance from each centroid to its nearest neighbour
+		std::fill(halfSeparation.begin(), halfSeparation.end(), FLT_MAX);
+		workers.parallelFor(k, [&](size_t begin, size_t end, unsigned int) {
+			for (size_t a = begin; a < end; ++a)
+			{
+				for (size_t b = 0; b < k; ++b)
+				{
+					if (a == b)
+						continue;
+					const float distance = 0.5f * sqrt(squaredDistance(centroids, a, centroids, b));
+					if (distance < halfSeparation[a])
+						halfSeparation[a] = distance;
+				}
+			}
+		});
+
+		// Assignment, accumulating the next centroids as we go
+		workers.parallelFor(n, [&](size_t begin, size_t end, unsigned int t) {
+			ThreadAccumulator &acc = accumulators[t];
+			std::fill(acc.sums.begin(), acc.sums.end(), 0.0);
+			std::fill(acc.counts.begin(), acc.counts.end(), 0);
+			acc.changed = false;
+
+			for (size_t i = begin; i < end; ++i)
+			{
+				uint32_t a = assignment[i];
+				const float bound = std::max(halfSeparation[a], lower[i]);
+				if (upper[i] > bound)
+				{
+					upper[i] = sqrt(squaredDistance(points, i, centroids, a));
+					if (upper[i] > bound)
+					{
+						// Bounds failed, scan every centroid for the two nearest
+						acc.scans++;
+						distancesToAll(points, i, centroids, acc.distances.data());
+						float best = FLT_MAX;
+						float second = FLT_MAX;
+						uint32_t bestIndex = a;
+						for (uint32_t j = 0; j < k; ++j)
+						{
+							const float distance = acc.distances[j];
+							if (distance < best)
+							{
+								second = best;
+								best = distance;
+								bestIndex = j;
+							}
+							else if (distance < second)
+							{
+								second = distance;
+							}
+						}
+
+						if (bestIndex != a)
+						{
+							a = bestIndex;
+							assignment[i] = a;
+							acc.changed = true;
+						}
+						upper[i] = sqrt(best);
+						lower[i] = sqrt(second);
+					}
+				}
+
+				acc.counts[a]++;
+				for (unsigned int d = 0; d < dims; ++d)
+					acc.sums[d * k + a] += points.coords[d][i];
+			}
+		});
+
+		// Merge thread accumulators into the new centroids
+		bool changed = iteration == 0;
+		previous.coords[0] = centroids.coords[0];
+		previous.coords[1] = centroids.coords[1];
+		previous.coords[2] = centroids.coords[2];
+		result.clusterSizes.assign(k, 0);
+		for (auto &acc : accumulators)
+		{
+			changed |= acc.changed;
+			for (unsigned int j = 0; j < k; ++j)
+				result.clusterSizes[j] += acc.counts[j];
+		}
+
+		for (unsigned int d = 0; d < dims; ++d)
+		{
+			for (unsigned int j = 0; j < k; ++j)
+			{
+				// Empty clusters keep their previous position
+				if (result.clusterSizes[j] == 0)
+					continue;
+
+				double sum = 0.0;
+				for (auto &acc : accumulators)
+					sum += acc.sums[d * k + j];
+				centroids.coords[d][j] = static_cast<float>(sum / result.clusterSizes[j]);
+			}
+		}
+
+		// Loosen the bounds by how far the centroids moved
+		float largest = 0.0f;
+		float secondLargest = 0.0f;
+		uint32_t largestIndex = 0;
+		for (uint32_t j = 0; j < k; ++j)
+		{
+			movement[j] = sqrt(squaredDistance(centroids, j, previous, j));
+			if (movement[j] > largest)
+			{
+				secondLargest = largest;
+				largest = movement[j];
+				largestIndex = j;
+			}
+			else if (movement[j] > secondLargest)
+			{
+				secondLargest = movement[j];
+			}
+		}
+
+		if (!changed || largest <= m_options.tolerance)
+			break;
+
+		workers.parallelFor(n, [&](size_t begin, size_t end, unsigned int) {
+			for (size_t i = begin; i < end; ++i)
+			{
+				const uint32_t a = assignment[i];
+				upper[i] += movement[a];
+				lower[i] -= a == largestIndex ? secondLargest : largest;
+			}
+		});
+	}
+
+	std::vector<double> inertia(threads, 0.0);
+	workers.parallelFor(n, [&](size_t begin, size_t end, unsigned int t) {
+		double sum = 0.0;
+		for (size_t i = begin; i < end; ++i)
+			sum += squaredDistance(points, i, centroids, assignment[i]);
+		inertia[t] = sum;
+	});
+
+	for (unsigned int t = 0; t < threads; ++t)
+	{
+		result.inertia += inertia[t];
+		result.distanceScans += accumulators[t].scans;
+	}
+
+	return result;
+}
@@ -0,0 +1,79 @@
+// Parallel k-means over Vec2f / Vec3f point sets
+//
+// Points are kept in structure-of-arrays form so distance loops run over
+// contiguous floats. Seeding is k-means++; Lloyd iterations use Hamerly's
+// bounds (one upper, one lower bound per point) to skip most distance
+// computations once clusters settle. Assignment runs on worker threads, each
+// with its own centroid accumulator, merged at the end of the iteration. The
+// workers are started once per run() and reused by every seeding and Lloyd pass.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "../../Vector/Vector.h"
+
+namespace mhe
+{
+
+class KMeansWorkers;
+
+struct PointSetSoA
+{
+	unsigned int dims = 3;
+	std::vector<float> coords[3];
+
+	size_t size() const { return coords[0].size(); }
+	void resize(size_t count);
+
+	static PointSetSoA fromPoints(const std::vector<Vec2f> &points);
+	static PointSetSoA fromPoints(const std::vector<Vec3f> &points);
+};
+
+struct KMeansOptions
+{
+	unsigned int k = 8;
+	unsigned int maxIterations = 100;
+
+	// Stop once no centroid moves further than this
+	float tolerance = 1e-4f;
+
+	// 0 uses std::thread::hardware_concurrency
+	unsigned int threads = 0;
+	uint64_t seed = 0x853C49E6748FEA9BULL;
+};
+
+struct KMeansResult
+{
+	PointSetSoA centroids;
+	std::vector<uint32_t> assignments;
+	std::vector<uint32_t> clusterSizes;
+	unsigned int iterations = 0;
+
+	// Sum of squared distances to the assigned centroid
+	double inertia = 0.0;
+
+	// Full nearest-centroid scans done, a measure of how much pruning helped
+	uint64_t distanceScans = 0;
+};
+
+class KMeans
+{
+public:
+	explicit KMeans(const KMeansOptions &options = KMeansOptions());
+	~KMeans() = default;
+
+	KMeansResult run(const PointSetSoA &points) const;
+	KMeansResult run(const std::vector<Vec2f> &points) const { return run(PointSetSoA::fromPoints(points)); }
+	KMeansResult run(const std::vector<Vec3f> &points) const { return run(PointSetSoA::fromPoints(points)); }
+
+private:
+	unsigned int threadCount() const;
+	void seed(const PointSetSoA &points, PointSetSoA &centroids, KMeansWorkers &workers) const;
+
+private:
+	KMeansOptions m_options;
+};
+
+} // mhe
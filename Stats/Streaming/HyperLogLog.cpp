@@ -0,0 +1,221 @@
+#include <math.h>
+#include <string.h>
+#include "HyperLogLog.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MHE_HYPERLOGLOG_SSE2
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace mhe;
+
+namespace
+{
+	// splitmix64 finalizer, spreads sequential keys over all 64 bits
+	inline uint64_t mixKey(uint64_t key)
+	{
+		key ^= key >> 30;
+		key *= 0xBF58476D1CE4E5B9ULL;
+		key ^= key >> 27;
+		key *= 0x94D049BB133111EBULL;
+		key ^= key >> 31;
+		return key;
+	}
+
+	// value is never 0 here: addHash sets a stop bit below the rank bits
+	inline unsigned int leadingZeros(uint64_t value)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse64(&index, value);
+		return 63 - index;
+#else
+		return __builtin_clzll(value);
+#endif
+	}
+
+#ifdef MHE_HYPERLOGLOG_SSE2
+	// Low 64 bits of a 64 x 64 multiply per lane; SSE2 only has 32 x 32 -> 64
+	inline __m128i multiply64(__m128i a, __m128i b)
+	{
+		const __m128i low = _mm_mul_epu32(a, b);
+		const __m128i cross = _mm_add_epi64(_mm_mul_epu32(_mm_srli_epi64(a, 32), b), _mm_mul_epu32(a, _mm_srli_epi64(b, 32)));
+		return _mm_add_epi64(low, _mm_slli_epi64(cross, 32));
+	}
+
+	// mixKey on two keys at once
+	inline __m128i mixKeys(__m128i keys)
+	{
+		const __m128i first = _mm_set1_epi64x(static_cast<long long>(0xBF58476D1CE4E5B9ULL));
+		const __m128i second = _mm_set1_epi64x(static_cast<long long>(0x94D049BB133111EBULL));
+		keys = _mm_xor_si128(keys, _mm_srli_epi64(keys, 30));
+		keys = multiply64(keys, first);
+		keys = _mm_xor_si128(keys, _mm_srli_epi64(keys, 27));
+		keys = multiply64(keys, second);
+		return _mm_xor_si128(keys, _mm_srli_epi64(keys, 31));
+	}
+#endif
+
+	const size_t HASH_BLOCK = 64;
+}
+
+HyperLogLog::HyperLogLog(unsigned int precision)
+	: m_precision(precision < 4 ? 4 : (precision > 18 ? 18 : precision))
+	, m_registers(static_cast<size_t>(1) << m_precision, 0)
+{
+}
+
+void HyperLogLog::reset()
+{
+	memset(m_registers.data(), 0, m_registers.size());
+}
+
+void HyperLogLog::addHash(uint64_t hash)
+{
+	// Top p bits pick the register, the rest give the rank
+	const size_t index = static_cast<size_t>(hash >> (64 - m_precision));
+	const uint64_t rest = (hash << m_precision) | (1ULL << (m_precision - 1));
+	const uint8_t rank = static_cast<uint8_t>(leadingZeros(rest) + 1);
+	if (rank > m_registers[index])
+		m_registers[index] = rank;
+}
+
+void HyperLogLog::add(uint64_t key)
+{
+	addHash(mixKey(key));
+}
+
+void HyperLogLog::add(float value)
+{
+	// +0 and -0 count as one value
+	if (value == 0.0f)
+		value = 0.0f;
+
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	addHash(mixKey(bits));
+}
+
+void HyperLogLog::add(const void *data, size_t length)
+{
+	// FNV-1a, then mixed so short keys still fill the high bits
+	const unsigned char *bytes = static_cast<const unsigned char *>(data);
+	uint64_t hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < length; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	addHash(mixKey(hash));
+}
+
+// Batches hash a block of keys first, two lanes at a time with SSE2, then rank
+// and update registers. The register update stays scalar: SSE2 has no scatter,
+// and keys in one block may hit the same register.
+void HyperLogLog::addBatch(const uint64_t *keys, size_t count)
+{
+	uint64_t hashes[HASH_BLOCK];
+	while (count > 0)
+	{
+		const size_t blockSize = count < HASH_BLOCK ? count : HASH_BLOCK;
+		size_t i = 0;
+#ifdef MHE_HYPERLOGLOG_SSE2
+		for (; i + 2 <= blockSize; i += 2)
+		{
+			const __m128i lanes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(keys + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(hashes + i), mixKeys(lanes));
+		}
+#endif
+		for (; i < blockSize; ++i)
+			hashes[i] = mixKey(keys[i]);
+		for (i = 0; i < blockSize; ++i)
+			addHash(hashes[i]);
+
+		keys += blockSize;
+		count -= blockSize;
+	}
+}
+
+void HyperLogLog::addBatch(const float *values, size_t count)
+{
+	uint64_t hashes[HASH_BLOCK];
+	while (count > 0)
+	{
+		const size_t blockSize = count < HASH_BLOCK ? count : HASH_BLOCK;
+		size_t i = 0;
+#ifdef MHE_HYPERLOGLOG_SSE2
+		// Adding +0 turns -0 into +0 and leaves every other value as is, then
+		// the float bits are zero extended to 64 bit keys like in add(float)
+		const __m128i zero = _mm_setzero_si128();
+		for (; i + 4 <= blockSize; i += 4)
+		{
+			const __m128 lanes = _mm_add_ps(_mm_loadu_ps(values + i), _mm_setzero_ps());
+			const __m128i bits = _mm_castps_si128(lanes);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(hashes + i), mixKeys(_mm_unpacklo_epi32(bits, zero)));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(hashes + i + 2), mixKeys(_mm_unpackhi_epi32(bits, zero)));
+		}
+#endif
+		for (; i < blockSize; ++i)
+		{
+			const float value = values[i] == 0.0f ? 0.0f : values[i];
+			uint32_t bits;
+			memcpy(&bits, &value, sizeof(bits));
+			hashes[i] = mixKey(bits);
+		}
+		for (i = 0; i < blockSize; ++i)
+			addHash(hashes[i]);
+
+		values += blockSize;
+		count -= blockSize;
+	}
+}
+
+bool HyperLogLog::merge(const HyperLogLog &other)
+{
+	if (other.m_precision != m_precision)
+		return false;
+
+	uint8_t *dst = m_registers.data();
+	const uint8_t *src = other.m_registers.data();
+	const size_t size = m_registers.size();
+	size_t i = 0;
+
+#ifdef MHE_HYPERLOGLOG_SSE2
+	for (; i + 16 <= size; i += 16)
+	{
+		const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+		const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_max_epu8(a, b));
+	}
+#endif
+	for (; i < size; ++i)
+		dst[i] = src[i] > dst[i] ? src[i] : dst[i];
+
+	return true;
+}
+
+double HyperLogLog::estimate() const
+{
+	const double m = static_cast<double>(m_registers.size());
+
+	double sum = 0.0;
+	unsigned int zeros = 0;
+	for (uint8_t value : m_registers)
+	{
+		sum += ldexp(1.0, -static_cast<int>(value));
+		zeros += value == 0;
+	}
+
+	const double alpha = 0.7213 / (1.0 + 1.079 / m);
+	const double raw = alpha * m * m / sum;
+
+	// Linear counting is more accurate while many registers are still empty
+	if (raw <= 2.5 * m && zeros > 0)
+		return m * log(m / zeros);
+
+	return raw;
+}
@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include <utility>
+#include "QuantileSketch.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MHE_QUANTILE_SKETCH_SSE2
+#endif
+
+using namespace mhe;
+
+namespace
+{
+	// Running min / max over values[0, count); NaNs are skipped like in push()
+	void minMax(const float *values, size_t count, float &minValue, float &maxValue)
+	{
+		size_t i = 0;
+#ifdef MHE_QUANTILE_SKETCH_SSE2
+		if (count >= 4)
+		{
+			// minps / maxps return the second operand when either is NaN
+			__m128 lanesMin = _mm_set1_ps(minValue);
+			__m128 lanesMax = _mm_set1_ps(maxValue);
+			for (; i + 4 <= count; i += 4)
+			{
+				const __m128 lanes = _mm_loadu_ps(values + i);
+				lanesMin = _mm_min_ps(lanes, lanesMin);
+				lanesMax = _mm_max_ps(lanes, lanesMax);
+			}
+
+			float mins[4], maxs[4];
+			_mm_storeu_ps(mins, lanesMin);
+			_mm_storeu_ps(maxs, lanesMax);
+			for (int lane = 0; lane < 4; ++lane)
+			{
+				minValue = mins[lane] < minValue ? mins[lane] : minValue;
+				maxValue = maxs[lane] > maxValue ? maxs[lane] : maxValue;
+			}
+		}
+#endif
+		for (; i < count; ++i)
+		{
+			minValue = values[i] < minValue ? values[i] : minValue;
+			maxValue = values[i] > maxValue ? values[i] : maxValue;
+		}
+	}
+}
+
+QuantileSketch::QuantileSketch(unsigned int k, uint64_t seed)
+	: m_k(k < 8 ? 8 : k)
+	, m_random(seed ? seed : 1)
+{
+	reset();
+}
+
+void QuantileSketch::reset()
+{
+	m_count = 0;
+	m_min = FLT_MAX;
+	m_max = -FLT_MAX;
+	m_retained = 0;
+	m_levels.assign(1, std::vector<float>());
+	updateCapacity();
+}
+
+unsigned int QuantileSketch::capacity(unsigned int level) const
+{
+	// Top level gets k, each level below shrinks by 2/3, never below 2
+	const unsigned int depth = static_cast<unsigned int>(m_levels.size()) - 1 - level;
+	const double scaled = m_k * pow(2.0 / 3.0, depth);
+	return scaled < 2.0 ? 2 : static_cast<unsigned int>(ceil(scaled));
+}
+
+bool QuantileSketch::nextCoin()
+{
+	// xorshift64
+	m_random ^= m_random << 13;
+	m_random ^= m_random >> 7;
+	m_random ^= m_random << 17;
+	return (m_random & 1) != 0;
+}
+
+void QuantileSketch::updateCapacity()
+{
+	m_totalCapacity = 0;
+	for (unsigned int level = 0; level < m_levels.size(); ++level)
+		m_totalCapacity += capacity(level);
+}
+
+void QuantileSketch::push(float value)
+{
+	m_count++;
+	m_min = value < m_min ? value : m_min;
+	m_max = value > m_max ? value : m_max;
+
+	m_levels[0].push_back(value);
+	if (++m_retained >= m_totalCapacity)
+		compress();
+}
+
+void QuantileSketch::pushBatch(const float *values, size_t count)
+{
+	// Fill level 0 in bulk and compact once per overflow instead of per item
+	while (count > 0)
+	{
+		const size_t room = m_totalCapacity > m_retained ? m_totalCapacity - m_retained : 1;
+		const size_t take = count < room ? count : room;
+
+		minMax(values, take, m_min, m_max);
+		m_levels[0].insert(m_levels[0].end(), values, values + take);
+		m_count += take;
+		m_retained += take;
+
+		if (m_retained >= m_totalCapacity)
+			compress();
+
+		values += take;
+		count -= take;
+	}
+}
+
+void QuantileSketch::compress()
+{
+	// Compact the lowest over-full level until everything fits the total budget
+	while (m_retained >= m_totalCapacity)
+	{
+		unsigned int level = 0;
+		while (level + 1 < m_levels.size() && m_levels[level].size() < capacity(level))
+			++level;
+
+		if (level + 1 == m_levels.size())
+		{
+			m_levels.emplace_back();
+			updateCapacity();
+		}
+
+		// Sort, then promote every other item (random offset) at double weight
+		std::vector<float> &items = m_levels[level];
+		std::sort(items.begin(), items.end());
+
+		// An odd item out stays at this level
+		const bool odd = items.size() % 2 != 0;
+		const float last = odd ? items.back() : 0.0f;
+
+		std::vector<float> &next = m_levels[level + 1];
+		const size_t pairs = items.size() / 2;
+		const size_t offset = nextCoin() ? 1 : 0;
+		for (size_t i = 0; i < pairs; ++i)
+			next.push_back(items[2 * i + offset]);
+
+		m_retained -= items.size() - pairs - (odd ? 1 : 0);
+		items.clear();
+		if (odd)
+			items.push_back(last);
+	}
+}
+
+void QuantileSketch::merge(const QuantileSketch &other)
+{
+	if (other.m_count == 0)
+		return;
+
+	if (m_levels.size() < other.m_levels.size())
+		m_levels.resize(other.m_levels.size());
+	for (size_t level = 0; level < other.m_levels.size(); ++level)
+		m_levels[level].insert(m_levels[level].end(), other.m_levels[level].begin(), other.m_levels[level].end());
+	m_retained += other.m_retained;
+	updateCapacity();
+
+	m_count += other.m_count;
+	m_min = other.m_min < m_min ? other.m_min : m_min;
+	m_max = other.m_max > m_max ? other.m_max : m_max;
+
+	compress();
+}
+
+double QuantileSketch::rank(float value) const
+{
+	if (m_count == 0)
+		return 0.0;
+
+	uint64_t weight = 0;
+	for (size_t level = 0; level < m_levels.size(); ++level)
+	{
+		for (float item : m_levels[level])
+		{
+			if (item <= value)
+				weight += 1ULL << level;
+		}
+	}
+
+	const double r = static_cast<double>(weight) / m_count;
+	return r > 1.0 ? 1.0 : r;
+}
+
+float QuantileSketch::quantile(double q) const
+{
+	if (m_count == 0)
+		return 0.0f;
+	if (q <= 0.0)
+		return m_min;
+	if (q >= 1.0)
+		return m_max;
+
+	std::vector<std::pair<float, uint64_t>> weighted;
+	weighted.reserve(retainedItems());
+	uint64_t totalWeight = 0;
+	for (size_t level = 0; level < m_levels.size(); ++level)
+	{
+		for (float item : m_levels[level])
+		{
+			weighted.emplace_back(item, 1ULL << level);
+			totalWeight += 1ULL << level;
+		}
+	}
+
+	std::sort(weighted.begin(), weighted.end());
+
+	const double target = q * totalWeight;
+	uint64_t cumulative = 0;
+	for (const auto &item : weighted)
+	{
+		cumulative += item.second;
+		if (cumulative >= target)
+			return item.first;
+	}
+
+	return m_max;
+}
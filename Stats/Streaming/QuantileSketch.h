@@ -0,0 +1,59 @@
+// KLL quantile sketch (Karnin, Lang, Liberty 2016)
+//
+// Keeps a hierarchy of compactors; level h holds items of weight 2^h. When a
+// level overflows it is sorted and every other item is promoted, so memory is
+// O(k log(n / k)) and the rank error is roughly 1.7 / k with high probability.
+// Sketches from different shards merge by concatenating levels and compacting.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace mhe
+{
+
+class QuantileSketch
+{
+public:
+	explicit QuantileSketch(unsigned int k = 200, uint64_t seed = 0x9E3779B97F4A7C15ULL);
+	~QuantileSketch() = default;
+
+	void push(float value);
+	void pushBatch(const float *values, size_t count);
+	void merge(const QuantileSketch &other);
+	void reset();
+
+	uint64_t count() const { return m_count; }
+	float min() const { return m_min; }
+	float max() const { return m_max; }
+
+	// q in [0, 1]; 0.5 is the median
+	float quantile(double q) const;
+
+	// Fraction of pushed values <= value
+	double rank(float value) const;
+
+	size_t retainedItems() const { return m_retained; }
+
+private:
+	unsigned int capacity(unsigned int level) const;
+	void updateCapacity();
+	void compress();
+	bool nextCoin();
+
+private:
+	unsigned int m_k;
+	uint64_t m_count;
+	uint64_t m_random;
+	float m_min;
+	float m_max;
+	size_t m_retained;
+	size_t m_totalCapacity;
+
+	// m_levels[h] holds items of weight 2^h
+	std::vector<std::vector<float>> m_levels;
+};
+
+} // mhe
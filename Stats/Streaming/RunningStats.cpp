@@ -0,0 +1,206 @@
+#include <float.h>
+#include <math.h>
+#include "RunningStats.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MHE_RUNNING_STATS_SSE2
+#endif
+
+using namespace mhe;
+
+namespace
+{
+	// Batches are summarized in blocks this size, then merged, so the float
+	// lane sums stay accurate on long inputs
+	const size_t BATCH_BLOCK = 4096;
+}
+
+RunningStats::RunningStats()
+{
+	reset();
+}
+
+void RunningStats::reset()
+{
+	m_count = 0;
+	m_mean = 0.0;
+	m_m2 = 0.0;
+	m_min = FLT_MAX;
+	m_max = -FLT_MAX;
+}
+
+double RunningStats::stddev() const
+{
+	return sqrt(variance());
+}
+
+void RunningStats::push(float value)
+{
+	m_count++;
+	const double delta = value - m_mean;
+	m_mean += delta / m_count;
+	m_m2 += delta * (value - m_mean);
+
+	m_min = value < m_min ? value : m_min;
+	m_max = value > m_max ? value : m_max;
+}
+
+void RunningStats::merge(const RunningStats &other)
+{
+	if (other.m_count == 0)
+		return;
+	if (m_count == 0)
+	{
+		*this = other;
+		return;
+	}
+
+	const uint64_t count = m_count + other.m_count;
+	const double delta = other.m_mean - m_mean;
+	m_mean += delta * other.m_count / count;
+	m_m2 += other.m_m2 + delta * delta * (static_cast<double>(m_count) * other.m_count / count);
+	m_count = count;
+
+	m_min = other.m_min < m_min ? other.m_min : m_min;
+	m_max = other.m_max > m_max ? other.m_max : m_max;
+}
+
+void RunningStats::pushBatch(const float *values, size_t count)
+{
+	while (count > 0)
+	{
+		const size_t blockSize = count < BATCH_BLOCK ? count : BATCH_BLOCK;
+
+		// Two passes over a cache resident block: sum/min/max, then squared deviations
+		RunningStats block;
+		size_t i = 0;
+		double sum = 0.0;
+		float low = FLT_MAX;
+		float high = -FLT_MAX;
+
+#ifdef MHE_RUNNING_STATS_SSE2
+		__m128 sum4 = _mm_setzero_ps();
+		__m128 min4 = _mm_set1_ps(FLT_MAX);
+		__m128 max4 = _mm_set1_ps(-FLT_MAX);
+		for (; i + 4 <= blockSize; i += 4)
+		{
+			const __m128 v = _mm_loadu_ps(values + i);
+			sum4 = _mm_add_ps(sum4, v);
+			min4 = _mm_min_ps(min4, v);
+			max4 = _mm_max_ps(max4, v);
+		}
+
+		float lanes[4];
+		_mm_storeu_ps(lanes, sum4);
+		sum = static_cast<double>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+		_mm_storeu_ps(lanes, min4);
+		for (int l = 0; l < 4; ++l)
+			low = lanes[l] < low ? lanes[l] : low;
+		_mm_storeu_ps(lanes, max4);
+		for (int l = 0; l < 4; ++l)
+			high = lanes[l] > high ? lanes[l] : high;
+#endif
+		for (; i < blockSize; ++i)
+		{
+			sum += values[i];
+			low = values[i] < low ? values[i] : low;
+			high = values[i] > high ? values[i] : high;
+		}
+
+		const float mean = static_cast<float>(sum / blockSize);
+		double m2 = 0.0;
+		i = 0;
+
+#ifdef MHE_RUNNING_STATS_SSE2
+		const __m128 mean4 = _mm_set1_ps(mean);
+		__m128 m24 = _mm_setzero_ps();
+		for (; i + 4 <= blockSize; i += 4)
+		{
+			const __m128 d = _mm_sub_ps(_mm_loadu_ps(values + i), mean4);
+			m24 = _mm_add_ps(m24, _mm_mul_ps(d, d));
+		}
+		_mm_storeu_ps(lanes, m24);
+		m2 = static_cast<double>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+#endif
+		for (; i < blockSize; ++i)
+		{
+			const double d = values[i] - mean;
+			m2 += d * d;
+		}
+
+		// Deviations were taken around the rounded float mean; correct to the exact one
+		const double exactMean = sum / blockSize;
+		const double shift = exactMean - mean;
+		block.m_count = blockSize;
+		block.m_mean = exactMean;
+		block.m_m2 = m2 - blockSize * shift * shift;
+		block.m_min = low;
+		block.m_max = high;
+		merge(block);
+
+		values += blockSize;
+		count -= blockSize;
+	}
+}
+
+void RunningVec3Stats::push(const Vec3f &v)
+{
+	m_x.push(v.x());
+	m_y.push(v.y());
+	m_z.push(v.z());
+}
+
+void RunningVec3Stats::pushBatch(const Vec3f *values, size_t count)
+{
+	// Transpose into small SoA blocks so every component takes the batch path
+	float xs[256];
+	float ys[256];
+	float zs[256];
+
+	while (count > 0)
+	{
+		const size_t blockSize = count < 256 ? count : 256;
+		for (size_t i = 0; i < blockSize; ++i)
+		{
+			xs[i] = values[i].x();
+			ys[i] = values[i].y();
+			zs[i] = values[i].z();
+		}
+		pushBatch(xs, ys, zs, blockSize);
+
+		values += blockSize;
+		count -= blockSize;
+	}
+}
+
+void RunningVec3Stats::pushBatch(const float *xs, const float *ys, const float *zs, size_t count)
+{
+	m_x.pushBatch(xs, count);
+	m_y.pushBatch(ys, count);
+	m_z.pushBatch(zs, count);
+}
+
+void RunningVec3Stats::merge(const RunningVec3Stats &other)
+{
+	m_x.merge(other.m_x);
+	m_y.merge(other.m_y);
+	m_z.merge(other.m_z);
+}
+
+void RunningVec3Stats::reset()
+{
+	m_x.reset();
+	m_y.reset();
+	m_z.reset();
+}
+
+Vec3f RunningVec3Stats::mean() const
+{
+	return Vec3f(static_cast<float>(m_x.mean()), static_cast<float>(m_y.mean()), static_cast<float>(m_z.mean()));
+}
+
+Vec3f RunningVec3Stats::variance() const
+{
+	return Vec3f(static_cast<float>(m_x.variance()), static_cast<float>(m_y.variance()), static_cast<float>(m_z.variance()));
+}
@@ -0,0 +1,71 @@
+// Single pass mean / variance / min / max (Welford)
+//
+// Accumulators are built per shard and combined with merge (Chan et al.), so a
+// data set split across threads gives the same result as one sequential pass.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../../Vector/Vec3.h"
+
+namespace mhe
+{
+
+class RunningStats
+{
+public:
+	RunningStats();
+	~RunningStats() = default;
+
+	void push(float value);
+	void pushBatch(const float *values, size_t count);
+	void merge(const RunningStats &other);
+	void reset();
+
+	uint64_t count() const { return m_count; }
+	double mean() const { return m_mean; }
+	double variance() const { return m_count > 1 ? m_m2 / (m_count - 1) : 0.0; }
+	double populationVariance() const { return m_count > 0 ? m_m2 / m_count : 0.0; }
+	double stddev() const;
+	float min() const { return m_min; }
+	float max() const { return m_max; }
+
+private:
+	uint64_t m_count;
+	double m_mean;
+	double m_m2;
+	float m_min;
+	float m_max;
+};
+
+// Per component statistics of Vec3f samples, e.g. positions
+class RunningVec3Stats
+{
+public:
+	RunningVec3Stats() = default;
+	~RunningVec3Stats() = default;
+
+	void push(const Vec3f &v);
+	void pushBatch(const Vec3f *values, size_t count);
+	void pushBatch(const float *xs, const float *ys, const float *zs, size_t count);
+	void merge(const RunningVec3Stats &other);
+	void reset();
+
+	uint64_t count() const { return m_x.count(); }
+	Vec3f mean() const;
+	Vec3f variance() const;
+	Vec3f min() const { return Vec3f(m_x.min(), m_y.min(), m_z.min()); }
+	Vec3f max() const { return Vec3f(m_x.max(), m_y.max(), m_z.max()); }
+
+	const RunningStats &x() const { return m_x; }
+	const RunningStats &y() const { return m_y; }
+	const RunningStats &z() const { return m_z; }
+
+private:
+	RunningStats m_x;
+	RunningStats m_y;
+	RunningStats m_z;
+};
+
+} // mhe